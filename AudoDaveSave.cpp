@@ -11,23 +11,101 @@ http://www.apache.org/licenses/LICENSE-2.0
 #include <windows.h>
 #include <commctrl.h>
 #include <shellapi.h>
+#include <wtsapi32.h>
+#include <compressapi.h>
+#include <winioctl.h>
+#include <winmeta.h>
+#include <TraceLoggingProvider.h>
 #include <string>
 #include <sstream>
+#include <iomanip>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <type_traits>
+#include <new>
+#include <cassert>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cwctype>
+
+#include "AutoDaveSaveMsgs.h"
+
+#pragma comment(lib, "wtsapi32.lib")
 
 // ================================
 // Notepad++ Messages and Events
 // ================================
 #define NPPMSG                  (WM_USER + 1000)
-#define NPPM_MENUCOMMAND        (NPPMSG + 48)
+#define NPPM_GETCURRENTSCINTILLA (NPPMSG + 4)
+#define NPPM_GETNBOPENFILES     (NPPMSG + 7)
+#define NPPM_CREATESCINTILLAHANDLE (NPPMSG + 20)
+#define NPPM_GETCURRENTDOCINDEX (NPPMSG + 23)
+#define NPPM_LOADSESSION        (NPPMSG + 34)
 #define NPPM_SETMENUITEMCHECK   (NPPMSG + 40)
+#define NPPM_GETPLUGINSCONFIGDIR (NPPMSG + 46)
+#define NPPM_MSGTOPLUGIN        (NPPMSG + 47)
+#define NPPM_GETFULLPATHFROMBUFFERID (NPPMSG + 58)
+#define NPPM_GETBUFFERIDFROMPOS (NPPMSG + 59)
+#define NPPM_GETCURRENTBUFFERID (NPPMSG + 60)
+#define NPPM_GETBUFFERENCODING  (NPPMSG + 66)
+#define NPPM_DOOPEN             (NPPMSG + 77)
+#define NPPM_SAVEFILE           (NPPMSG + 94)
+
+#define MAIN_VIEW               0
+#define SUB_VIEW                1
+
+// NPPM_GETNBOPENFILES
+#define PRIMARY_VIEW            1
+#define SECOND_VIEW             2
 
 #define NPPN_FIRST              1000
 #define NPPN_READY              (NPPN_FIRST + 1)
+#define NPPN_FILEBEFORECLOSE    (NPPN_FIRST + 3)
+#define NPPN_FILEOPENED         (NPPN_FIRST + 4)
+#define NPPN_FILECLOSED         (NPPN_FIRST + 5)
+#define NPPN_FILESAVED          (NPPN_FIRST + 8)
+#define NPPN_SHUTDOWN           (NPPN_FIRST + 9)
+#define NPPN_BUFFERACTIVATED    (NPPN_FIRST + 10)
+#define NPPN_DOCORDERCHANGED    (NPPN_FIRST + 17)
+#define NPPN_SNAPSHOTDIRTYFILELOADED (NPPN_FIRST + 18)
+#define NPPN_FILERENAMED        (NPPN_FIRST + 23)
 
-// Notepad++ command: File -> Save All (typical builds)
-#define IDM_FILE                41000
-#define CMD_SAVEALL             (IDM_FILE + 7)   // 41007 Save All
+// ================================
+// Scintilla Messages and Events
+// ================================
+#define SCI_CLEARALL            2004
+#define SCI_GETLENGTH           2006
+#define SCI_GETCURRENTPOS       2008
+#define SCI_GETANCHOR           2009
+#define SCI_BEGINUNDOACTION     2078
+#define SCI_ENDUNDOACTION       2079
+#define SCI_SETSAVEPOINT        2014
+#define SCI_GETFIRSTVISIBLELINE 2152
+#define SCI_GETMODIFY           2159
+#define SCI_APPENDTEXT          2282
+#define SCI_GETDOCPOINTER       2357
+#define SCI_SETDOCPOINTER       2358
+#define SCI_ADDREFDOCUMENT      2376
+#define SCI_RELEASEDOCUMENT     2377
+#define SCI_GETCHARACTERPOINTER 2520
+
+#define SCN_SAVEPOINTREACHED    2002
+#define SCN_SAVEPOINTLEFT       2003
+#define SCN_UPDATEUI            2007
+#define SCN_MODIFIED            2008
+
+#define SC_MOD_INSERTTEXT       0x1
+#define SC_MOD_DELETETEXT       0x2
+
+#define SC_UPDATE_SELECTION     0x2
+#define SC_UPDATE_V_SCROLL      0x4
 
 // ================================
 // Notepad++ Plugin API Types
@@ -56,9 +134,40 @@ struct NppData
     HWND _scintillaSecondHandle;
 };
 
+// NPPM_MSGTOPLUGIN payload; commands are listed in AutoDaveSaveMsgs.h
+struct CommunicationInfo
+{
+    long internalMsg;
+    const wchar_t* srcModuleName;
+    void* info;
+};
+
+// Scintilla 5 layout (Sci_Position is pointer sized)
 struct SCNotification
 {
     NMHDR nmhdr;
+    intptr_t position;
+    int ch;
+    int modifiers;
+    int modificationType;
+    const char* text;
+    intptr_t length;
+    intptr_t linesAdded;
+    int message;
+    uintptr_t wParam;
+    intptr_t lParam;
+    intptr_t line;
+    int foldLevelNow;
+    int foldLevelPrev;
+    int margin;
+    int listType;
+    int x;
+    int y;
+    int token;
+    intptr_t annotationLinesAdded;
+    int updated;
+    int listCompletionMethod;
+    int characterSource;
 };
 
 // ================================
@@ -66,14 +175,35 @@ struct SCNotification
 // ================================
 static HINSTANCE g_hInst = nullptr;
 static HWND g_hNppWnd = nullptr;
+static HWND g_hSciMain = nullptr;
+static HWND g_hSciSecond = nullptr;
+
+// Hidden view used to read documents that are not on screen
+static HWND g_hSciReader = nullptr;
+static LRESULT g_readerBlankDoc = 0;
 
-// Autosave timer uses TIMERPROC
-static UINT_PTR g_autosaveTimerId = 0;
+// Deadline scheduler uses one TIMERPROC timer, armed for the earliest buffer
+static UINT_PTR g_schedTimerId = 0;
+static ULONGLONG g_armedDue = 0;
 
-// Debug window uses WM_TIMER refresh
+// Typing-pause timer uses TIMERPROC, armed on the first edit after a save
+static UINT_PTR g_idleTimerId = 0;
+
+// Journal flush timer uses TIMERPROC, armed on the first delta after a flush
+static UINT_PTR g_journalTimerId = 0;
+
+// Session checkpoint timer uses TIMERPROC, armed on the first tab change after a write
+static UINT_PTR g_sessionTimerId = 0;
+
+// Debug window refreshes when something it shows changes, never on a poll
 static HWND g_hDbgWnd = nullptr;
 static HWND g_hDbgEdit = nullptr;
-static UINT_PTR g_dbgTimerId = 0;
+static UINT_PTR g_dbgTimerId = 0;                    // Pending rate-limited refresh
+static std::atomic<HWND> g_dbgNotifyWnd{ nullptr };  // Read by writer workers
+static std::atomic<bool> g_dbgPosted{ false };
+static bool g_dbgStale = false;                      // Changed while hidden or minimized
+static ULONGLONG g_dbgLastRefresh = 0;
+static std::vector<std::wstring> g_dbgLines;         // What the edit control shows now
 
 // About window
 static HWND g_hAboutWnd = nullptr;
@@ -81,28 +211,160 @@ static HWND g_hAboutEdit = nullptr;
 static HWND g_hAboutBtnRepo = nullptr;
 static HWND g_hAboutBtnLinkedIn = nullptr;
 
-// ---------------- HARD-CODED DEFAULTS ----------------
+// ---------------- DEFAULTS (AutoDaveSave.ini overrides) ----------------
 static int  g_minutes = 3;
 static bool g_enabled = true;      // Start autosave on startup
 static bool g_debug = false;       // Debug window hidden on startup
-
-// Timer bookkeeping for debug countdown
+static bool g_idleMode = false;    // Save after typing pauses, interval becomes a cap
+static int  g_idleSeconds = 5;     // Quiet time required before a typing-pause save
+static bool g_saveOnLeave = false; // Save a tab when the user switches away or leaves Notepad++
+static bool g_snapshotOnly = false; // Write background shadow copies instead of saving files
+static bool g_journal = false;     // Append edit deltas between full saves
+static bool g_history = false;     // Keep a compressed ring of earlier versions per tab
+static bool g_sessionCheckpoint = false; // Keep a copy of the open tabs and their positions
+static int  g_journalSeconds = 2;  // Delay between the first delta and its append
+static bool g_adaptive = false;    // Stretch intervals so saves stay within the UI budget
+static int  g_warmupSeconds = 30;  // Quiet period after NPPN_READY while the session settles
+static int  g_jitterSeconds = 15;  // Random extra warm-up, so machines started together spread out
+static double g_uiBudgetPct = 1.0; // Share of wall time autosave may hold the UI thread
+
+// Timer bookkeeping for the debug view
 static DWORD     g_intervalMs = 0;
-static ULONGLONG g_nextTick = 0;
+static ULONGLONG g_lastEditTick = 0;
+
+// Startup: nothing is armed before NPPN_READY plus the warm-up
+static bool      g_ready = false;
+static ULONGLONG g_warmupUntil = 0;
+static ULONGLONG g_turnAt = 0;         // Tick turn reserved with other instances
+
+// Power awareness: the scheduler holds while any of these is set
+static bool      g_pausedLocked = false;
+static bool      g_pausedSuspended = false;
+static bool      g_pausedSaver = false;
+static bool      g_pausedApi = false;       // ADSM_PAUSE from another plugin
+static ULONGLONG g_apiPauseUntil = 0;
+static UINT_PTR  g_apiPauseTimerId = 0;
+static ULONGLONG g_pauseStart = 0;
+static DWORD     g_pauseCount = 0;
+static HWND      g_hPowerWnd = nullptr;
+static HPOWERNOTIFY g_hSaverNotify = nullptr;
+static HPOWERNOTIFY g_hEnergyNotify = nullptr;
+
+// Debug telemetry (UI thread; per-save events go through the telemetry ring)
+static DWORD      g_lastTickSaved = 0;
+static DWORD      g_lastTickUntitled = 0;
+
+// Outcome of the autosave rules for one buffer; set holds the kRule* bits
+// of the settings a rule decided, the rest follow the menu
+static constexpr uint8_t kRuleNever = 1;
+static constexpr uint8_t kRuleInterval = 2;
+static constexpr uint8_t kRuleSnapshot = 4;
+static constexpr uint8_t kRuleAdaptive = 8;
+
+struct RuleAction
+{
+    uint8_t set = 0;
+    bool    never = false;
+    bool    snapshot = false;
+    bool    adaptive = false;
+    DWORD   intervalMs = 0;
+};
+
+// Dirty buffer table, sorted by Notepad++ BufferID
+struct BufferEntry
+{
+    UINT_PTR id = 0;
+    bool     dirty = false;
+    bool     stale = false;    // Edited since the last background snapshot
+    LRESULT  doc = 0;          // Scintilla document, recorded while visible
+
+    // Change journal
+    bool     cleanBase = false;   // Document known to match the file on disk
+    bool     journalOpen = false; // Journal file started for the current base
+    bool     journalFresh = false;// Pending bytes start with a header (rewrite file)
+    bool     journalDrop = false; // Journal obsolete, delete on next flush
+    std::string journal;          // Bytes not yet handed to the writer
+    uint64_t journalBytes = 0;    // Delta bytes since the current base
+
+    // Content hash of the last saved text, with the file stamp it belongs to
+    bool     savedHashKnown = false;
+    bool     matchesSaved = false; // Verified equal since the last edit
+    uint64_t savedHash = 0;
+    uint64_t savedLength = 0;
+    uint64_t savedDiskSize = 0;
+    uint64_t savedDiskTime = 0;
+    bool     snapHashKnown = false;
+    uint64_t snapHash = 0;
+
+    // Last text handed to the version history
+    bool     histHashKnown = false;
+    uint64_t histHash = 0;
+
+    bool     recoveryChecked = false;   // Looked up in the recovery index
+
+    // Caret and scroll position for the session checkpoint, recorded while visible
+    intptr_t  anchor = 0;
+    intptr_t  caret = 0;
+    intptr_t  firstLine = 0;
+
+    // Autosave rules matched on open, save and rename
+    RuleAction rule;
+
+    // Deadline scheduler
+    DWORD     intervalMs = 0;      // Per-tab override, 0 uses the rules or the global interval
+    ULONGLONG pendingSince = 0;
+    ULONGLONG due = 0;             // 0 when not scheduled
+    uint32_t  schedGen = 0;        // Invalidates older heap entries
+
+    // UI-thread time of this buffer's autosave, smoothed
+    bool      costKnown = false;
+    double    costMs = 0.0;
+};
+
+// Min-heap entry; stale entries are dropped lazily when they reach the top
+struct Deadline
+{
+    ULONGLONG due = 0;
+    UINT_PTR  id = 0;
+    uint32_t  gen = 0;
+};
 
-// Debug telemetry
-static bool       g_lastSaveValid = false;
-static SYSTEMTIME g_lastSaveLocal{};
-static bool       g_lastErrValid = false;
-static DWORD      g_lastErrCode = 0;
+static std::vector<Deadline> g_deadlines;
+
+static std::vector<BufferEntry> g_buffers;
+static size_t g_dirtyCount = 0;
+static size_t g_staleCount = 0;
+
+// Buffer shown in MAIN_VIEW / SUB_VIEW as of the last sync
+static UINT_PTR g_viewBuffer[2] = { 0, 0 };
+
+// Background writer telemetry (written by the writer workers)
+static std::atomic<DWORD> g_writesDone{ 0 };
+static std::atomic<DWORD> g_writesFailed{ 0 };
+static DWORD g_lastTickQueued = 0;
+static DWORD g_lastTickHashSkipped = 0;
+static DWORD g_hashSkippedTotal = 0;
+static uint64_t g_savedTotal = 0;
+static uint64_t g_queuedTotal = 0;
+static uint64_t g_ticksRun = 0;
+static uint64_t g_journalAppended = 0;
+static DWORD g_journalCompactions = 0;
+
+// Backpressure: work skipped because an earlier save had not completed
+static bool  g_saveBusy = false;          // Inside RunAutosave; modal prompts pump timers
+static DWORD g_busyTicksSkipped = 0;
+static DWORD g_lastTickBackpressure = 0;
+static DWORD g_backpressureTotal = 0;
 
 // Links
 static constexpr const wchar_t* kRepoUrl = L"https://github.com/netwebdave/AutoDaveSave";
 static constexpr const wchar_t* kLinkedInUrl = L"https://www.linkedin.com/in/dsii/";
 
 // UI constants
-static constexpr int kDbgTimerRefreshMs = 1000;
+static constexpr int kDbgMinRefreshMs = 250;
 static constexpr UINT_PTR kDbgTimerId = 9001;
+static constexpr UINT kDbgRefreshMsg = WM_APP + 1;
+static constexpr UINT kLeaveSaveMsg = WM_APP + 2;
 
 // Menu indices
 enum : int
@@ -111,6 +373,18 @@ enum : int
     FUNC_1MIN,
     FUNC_3MIN,
     FUNC_10MIN,
+    FUNC_ADAPTIVE,
+    FUNC_IDLE,
+    FUNC_LEAVE,
+    FUNC_TABINTERVAL,
+    FUNC_SNAPSHOT,
+    FUNC_JOURNAL,
+    FUNC_RECOVER,
+    FUNC_HISTORY,
+    FUNC_RESTORE,
+    FUNC_SESSION,
+    FUNC_LOADSESSION,
+    FUNC_RULES,
     FUNC_DEBUG,
     FUNC_ABOUT,
     FUNC_COUNT
@@ -146,6 +420,37 @@ static std::wstring FormatHHMMSS(const SYSTEMTIME& st)
     return ss.str();
 }
 
+// Local wall-clock time of a UTC FILETIME value
+static std::wstring FormatUtcClock(const uint64_t utc)
+{
+    FILETIME ft{}, local{};
+    ft.dwLowDateTime = (DWORD)utc;
+    ft.dwHighDateTime = (DWORD)(utc >> 32);
+
+    SYSTEMTIME st{};
+    if (!FileTimeToLocalFileTime(&ft, &local) || !FileTimeToSystemTime(&local, &st)) return L"--:--:--";
+    return FormatHHMMSS(st);
+}
+
+// Wall-clock time of a GetTickCount64 value, so the debug window shows when
+// something happens instead of a countdown that would need a ticking timer
+static std::wstring FormatTickClock(const ULONGLONG tick)
+{
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+
+    const int64_t deltaMs = (int64_t)(tick - GetTickCount64());
+    return FormatUtcClock((((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime) + (uint64_t)(deltaMs * 10000));
+}
+
+// Any thread: ask the debug window to refresh. At most one request is in
+// the queue at a time, so a burst of events costs one rebuild.
+static void NotifyDebugChanged()
+{
+    const HWND hwnd = g_dbgNotifyWnd.load();
+    if (hwnd && !g_dbgPosted.exchange(true)) PostMessageW(hwnd, kDbgRefreshMsg, 0, 0);
+}
+
 // Initial checkmarks used while Notepad++ builds the Plugins menu
 static void UpdateInitChecks()
 {
@@ -153,6 +458,18 @@ static void UpdateInitChecks()
     g_items[FUNC_1MIN]._init2Check = (g_minutes == 1);
     g_items[FUNC_3MIN]._init2Check = (g_minutes == 3);
     g_items[FUNC_10MIN]._init2Check = (g_minutes == 10);
+    g_items[FUNC_ADAPTIVE]._init2Check = g_adaptive;
+    g_items[FUNC_IDLE]._init2Check = g_idleMode;
+    g_items[FUNC_LEAVE]._init2Check = g_saveOnLeave;
+    g_items[FUNC_TABINTERVAL]._init2Check = false;
+    g_items[FUNC_SNAPSHOT]._init2Check = g_snapshotOnly;
+    g_items[FUNC_JOURNAL]._init2Check = g_journal;
+    g_items[FUNC_RECOVER]._init2Check = false;
+    g_items[FUNC_HISTORY]._init2Check = g_history;
+    g_items[FUNC_RESTORE]._init2Check = false;
+    g_items[FUNC_SESSION]._init2Check = g_sessionCheckpoint;
+    g_items[FUNC_LOADSESSION]._init2Check = false;
+    g_items[FUNC_RULES]._init2Check = false;
     g_items[FUNC_DEBUG]._init2Check = g_debug;
     g_items[FUNC_ABOUT]._init2Check = false;
 }
@@ -166,102 +483,5305 @@ static void UpdateRuntimeChecks()
     SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_1MIN]._cmdID, (LPARAM)(g_minutes == 1 ? TRUE : FALSE));
     SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_3MIN]._cmdID, (LPARAM)(g_minutes == 3 ? TRUE : FALSE));
     SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_10MIN]._cmdID, (LPARAM)(g_minutes == 10 ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_ADAPTIVE]._cmdID, (LPARAM)(g_adaptive ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_IDLE]._cmdID, (LPARAM)(g_idleMode ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_LEAVE]._cmdID, (LPARAM)(g_saveOnLeave ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_SNAPSHOT]._cmdID, (LPARAM)(g_snapshotOnly ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_JOURNAL]._cmdID, (LPARAM)(g_journal ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_HISTORY]._cmdID, (LPARAM)(g_history ? TRUE : FALSE));
+    SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_SESSION]._cmdID, (LPARAM)(g_sessionCheckpoint ? TRUE : FALSE));
     SendMessageW(g_hNppWnd, NPPM_SETMENUITEMCHECK, (WPARAM)g_items[FUNC_DEBUG]._cmdID, (LPARAM)(g_debug ? TRUE : FALSE));
 }
 
+static void SaveSettings();
+
+// Every menu change ends here, so this is also where settings persist
 static void ApplyChecks()
 {
     UpdateInitChecks();
     UpdateRuntimeChecks();
+    SaveSettings();
 }
 
 // ================================
-// Autosave Timer
+// Paths
 // ================================
-static void StopAutosaveTimer()
+static std::wstring GetBufferPath(const UINT_PTR id)
 {
-    if (!g_autosaveTimerId) return;
-    KillTimer(nullptr, g_autosaveTimerId);
-    g_autosaveTimerId = 0;
+    if (!g_hNppWnd || !id) return std::wstring();
+
+    const LRESULT len = SendMessageW(g_hNppWnd, NPPM_GETFULLPATHFROMBUFFERID, (WPARAM)id, 0);
+    if (len <= 0) return std::wstring();
+
+    std::wstring path((size_t)len + 1, L'\0');
+    SendMessageW(g_hNppWnd, NPPM_GETFULLPATHFROMBUFFERID, (WPARAM)id, (LPARAM)&path[0]);
+    path.resize((size_t)len);
+    return path;
 }
 
-void CALLBACK AutosaveTimerProc(HWND, UINT, UINT_PTR, DWORD)
+// Untitled tabs report a bare name such as "new 1"
+static bool IsNamedPath(const std::wstring& path)
 {
-    if (!g_enabled) return;
-    if (!g_hNppWnd) return;
+    return path.find_first_of(L"\\/") != std::wstring::npos;
+}
+
+// FNV-1a over the case-folded path; Windows paths are case-insensitive
+static uint64_t HashPath(const std::wstring& path)
+{
+    uint64_t h = 14695981039346656037ull;
+    for (const wchar_t c : path)
+    {
+        h ^= (uint64_t)(uint16_t)towlower(c);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+static std::wstring HexU64(const uint64_t v)
+{
+    static const wchar_t* digits = L"0123456789abcdef";
+
+    std::wstring out(16, L'0');
+    for (int i = 15, shift = 0; i >= 0; --i, shift += 4)
+        out[(size_t)i] = digits[(v >> shift) & 0xF];
+    return out;
+}
+
+// <plugins config>\AutoDaveSave\<sub>, created on first use
+static std::wstring PluginDataDir(const wchar_t* sub)
+{
+    if (!g_hNppWnd) return std::wstring();
+
+    wchar_t cfg[MAX_PATH * 4] = {};
+    SendMessageW(g_hNppWnd, NPPM_GETPLUGINSCONFIGDIR, (WPARAM)_countof(cfg), (LPARAM)cfg);
+    if (!cfg[0]) return std::wstring();
+
+    std::wstring dir = cfg;
+    dir += L"\\AutoDaveSave";
+    CreateDirectoryW(dir.c_str(), nullptr);
+
+    if (sub && *sub)
+    {
+        dir += L"\\";
+        dir += sub;
+        CreateDirectoryW(dir.c_str(), nullptr);
+    }
+    return dir;
+}
+
+// "<file name>.<path hash>.<ext>" keeps same-named files from colliding
+static std::wstring StoreNameFor(const std::wstring& path, const wchar_t* ext)
+{
+    const size_t slash = path.find_last_of(L"\\/");
+    std::wstring name = (slash == std::wstring::npos) ? path : path.substr(slash + 1);
+    if (name.empty()) name = L"unnamed";
+
+    return name + L"." + HexU64(HashPath(path)) + L"." + ext;
+}
+
+static uint64_t FileTimeU64(const FILETIME& ft)
+{
+    return ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+}
+
+// "C:" or "\\server\share"
+static std::wstring VolumeOf(const std::wstring& path)
+{
+    if (path.size() >= 2 && (path[0] == L'\\' || path[0] == L'/') && (path[1] == L'\\' || path[1] == L'/'))
+    {
+        size_t end = path.find_first_of(L"\\/", 2);
+        if (end != std::wstring::npos) end = path.find_first_of(L"\\/", end + 1);
+        return path.substr(0, end);
+    }
+    return path.substr(0, path.find_first_of(L"\\/"));
+}
+
+static bool GetDiskStamp(const std::wstring& path, uint64_t& size, uint64_t& writeTime)
+{
+    WIN32_FILE_ATTRIBUTE_DATA fad{};
+    if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &fad)) return false;
+
+    size = ((uint64_t)fad.nFileSizeHigh << 32) | fad.nFileSizeLow;
+    writeTime = FileTimeU64(fad.ftLastWriteTime);
+    return true;
+}
+
+// ================================
+// Dirty Buffer Tracking
+// ================================
+static void UpdateSchedule(BufferEntry& e);
+static void EvaluateRules(BufferEntry& e);
+static void PushDeadline(BufferEntry& e);
+
+static std::vector<BufferEntry>::iterator LowerBoundBuffer(const UINT_PTR id)
+{
+    return std::lower_bound(g_buffers.begin(), g_buffers.end(), id,
+        [](const BufferEntry& e, const UINT_PTR key) { return e.id < key; });
+}
+
+static BufferEntry* FindBuffer(const UINT_PTR id)
+{
+    auto it = LowerBoundBuffer(id);
+    return (it != g_buffers.end() && it->id == id) ? &*it : nullptr;
+}
+
+// Returned reference is valid until the next insert or erase
+static BufferEntry& TouchBuffer(const UINT_PTR id)
+{
+    auto it = LowerBoundBuffer(id);
+    if (it == g_buffers.end() || it->id != id)
+    {
+        BufferEntry e;
+        e.id = id;
+        it = g_buffers.insert(it, e);
+        EvaluateRules(*it);
+    }
+    return *it;
+}
+
+static void SetBufferStale(BufferEntry& e, const bool stale)
+{
+    if (e.stale == stale) return;
+
+    e.stale = stale;
+    if (stale) ++g_staleCount;
+    else --g_staleCount;
+
+    UpdateSchedule(e);
+}
+
+static void SetBufferDirty(const UINT_PTR id, const bool dirty)
+{
+    if (!id) return;
+
+    BufferEntry& e = TouchBuffer(id);
+
+    // A clean buffer matches its file, so there is nothing left to snapshot
+    // or journal; the old journal is deleted on the next flush
+    if (!dirty)
+    {
+        SetBufferStale(e, false);
+        e.cleanBase = true;
+
+        if (e.journalOpen || !e.journal.empty())
+        {
+            e.journalOpen = false;
+            e.journalFresh = false;
+            e.journalDrop = true;
+            e.journal.clear();
+            e.journalBytes = 0;
+        }
+    }
+
+    if (e.dirty == dirty) return;
+
+    e.dirty = dirty;
+    if (dirty) ++g_dirtyCount;
+    else --g_dirtyCount;
+
+    UpdateSchedule(e);
+    NotifyDebugChanged();
+}
+
+static void RemoveBuffer(const UINT_PTR id)
+{
+    auto it = LowerBoundBuffer(id);
+    if (it == g_buffers.end() || it->id != id) return;
+
+    if (it->dirty) --g_dirtyCount;
+    if (it->stale) --g_staleCount;
+    g_buffers.erase(it);
+
+    for (UINT_PTR& v : g_viewBuffer)
+        if (v == id) v = 0;
+}
+
+// Buffer currently shown in the given Scintilla view
+static UINT_PTR BufferIdForView(const HWND hSci)
+{
+    if (!g_hNppWnd) return 0;
+
+    const int view = (hSci && hSci == g_hSciSecond) ? SUB_VIEW : MAIN_VIEW;
+    const LRESULT index = SendMessageW(g_hNppWnd, NPPM_GETCURRENTDOCINDEX, 0, (LPARAM)view);
+    if (index < 0) return 0;
+
+    return (UINT_PTR)SendMessageW(g_hNppWnd, NPPM_GETBUFFERIDFROMPOS, (WPARAM)index, (LPARAM)view);
+}
+
+// Re-read which buffers are on screen, their documents and modify flags.
+// Covers buffers whose savepoint change happened before the plugin could observe it.
+static void SyncVisibleDirtyState()
+{
+    const HWND views[] = { g_hSciMain, g_hSciSecond };
+
+    for (int v = 0; v < 2; ++v)
+    {
+        const HWND hSci = views[v];
+        g_viewBuffer[v] = hSci ? BufferIdForView(hSci) : 0;
+
+        const UINT_PTR id = g_viewBuffer[v];
+        if (!id) continue;
+
+        SetBufferDirty(id, SendMessageW(hSci, SCI_GETMODIFY, 0, 0) != 0);
+        TouchBuffer(id).doc = SendMessageW(hSci, SCI_GETDOCPOINTER, 0, 0);
+    }
+}
+
+// Text changed in a view: its buffer needs a fresh snapshot
+static void MarkViewEdited(const HWND hSci)
+{
+    const int v = (hSci == g_hSciSecond) ? SUB_VIEW : MAIN_VIEW;
+    if (!g_viewBuffer[v]) g_viewBuffer[v] = BufferIdForView(hSci);
+    if (!g_viewBuffer[v]) return;
+
+    BufferEntry& e = TouchBuffer(g_viewBuffer[v]);
+    SetBufferStale(e, true);
+    e.matchesSaved = false;
+}
+
+// ================================
+// Text Buffer Pool
+// ================================
+// Document copies are the plugin's largest allocations. They back snapshots,
+// version captures and history fallbacks: a 100 MB log can be copied every
+// few minutes and freed by a writer worker a moment later. In a 32-bit
+// Notepad++ that churn fragments the address space until one copy no longer
+// finds a hole. Copies of 1 MB and more therefore come from a few pooled
+// strings that keep their capacity. A miss reserves the copy plus an eighth,
+// rounded up to 1 MB, so a growing file keeps reusing the same block. The
+// largest recent copy only decides which blocks are worth keeping: one sized
+// for a file no longer copied is freed instead of pooled. The pool empties
+// once it has gone unused for a minute.
+static constexpr size_t kPoolSlots = 4;
+static constexpr size_t kPoolStep = (size_t)1 << 20;
+#if defined(_WIN64)
+static constexpr size_t kPoolMaxBytes = (size_t)1 << 30;
+#else
+static constexpr size_t kPoolMaxBytes = (size_t)256 << 20;
+#endif
+static constexpr DWORD kPoolIdleMs = 60u * 1000u;
+
+static std::mutex g_poolLock;
+static std::vector<std::string> g_pool;   // Cleared strings, capacity kept
+static size_t    g_poolBytes = 0;         // Capacity held in g_pool
+static size_t    g_poolRecentMax = 0;     // Largest copy since the pool last emptied
+static ULONGLONG g_poolLastUse = 0;
+static uint64_t  g_poolHits = 0;
+static uint64_t  g_poolMisses = 0;
+static UINT_PTR  g_poolTimerId = 0;       // UI thread
+
+// Copy plus headroom, in whole pool steps
+static size_t PoolBlockSize(const size_t bytes)
+{
+    const size_t want = bytes + bytes / 8;
+    return (want + kPoolStep - 1) / kPoolStep * kPoolStep;
+}
+
+// Any thread: an empty string that holds bytes without reallocating
+static std::string AcquireText(const size_t bytes)
+{
+    std::string out;
+    if (bytes < kPoolStep) return out;
+
+    size_t reserve = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_poolLock);
+        g_poolLastUse = GetTickCount64();
+        if (bytes > g_poolRecentMax) g_poolRecentMax = bytes;
+
+        // Best fit keeps the big blocks for the big files
+        size_t best = g_pool.size();
+        for (size_t i = 0; i < g_pool.size(); ++i)
+            if (g_pool[i].capacity() >= bytes && (best == g_pool.size() || g_pool[i].capacity() < g_pool[best].capacity()))
+                best = i;
+
+        if (best < g_pool.size())
+        {
+            out.swap(g_pool[best]);
+            g_pool.erase(g_pool.begin() + (ptrdiff_t)best);
+            g_poolBytes -= out.capacity();
+            ++g_poolHits;
+            return out;
+        }
+
+        ++g_poolMisses;
+        reserve = PoolBlockSize(bytes);
+    }
+
+    // No headroom is better than an exception out of a timer callback; the
+    // copy then allocates exactly what it needs
+    try { out.reserve(reserve); }
+    catch (const std::bad_alloc&) {}
+    return out;
+}
+
+// Any thread: give a copy's storage back once its bytes are no longer needed
+static void ReleaseText(std::string&& text)
+{
+    if (text.capacity() < kPoolStep) return;
+
+    std::string keep(std::move(text));
+    keep.clear();
+
+    std::string evicted;
+    {
+        std::lock_guard<std::mutex> lock(g_poolLock);
+
+        // A step larger than any recent copy needs (allocators round up a
+        // little): let it go
+        if (keep.capacity() > PoolBlockSize(g_poolRecentMax) + kPoolStep) return;
+
+        // Full: only a larger block displaces the smallest one
+        if (g_pool.size() >= kPoolSlots)
+        {
+            auto smallest = std::min_element(g_pool.begin(), g_pool.end(),
+                [](const std::string& a, const std::string& b) { return a.capacity() < b.capacity(); });
+            if (smallest->capacity() >= keep.capacity()) return;
+
+            g_poolBytes -= smallest->capacity();
+            evicted.swap(*smallest);
+            g_pool.erase(smallest);
+        }
+        if (g_poolBytes + keep.capacity() > kPoolMaxBytes) return;
+
+        g_poolBytes += keep.capacity();
+        g_pool.push_back(std::move(keep));
+    }
+}
+
+// Grow out through the pool before a large copy lands in it
+static void ReserveText(std::string& out, const size_t bytes)
+{
+    if (out.capacity() >= bytes || bytes < kPoolStep) return;
+
+    std::string pooled = AcquireText(bytes);
+    out.swap(pooled);
+    ReleaseText(std::move(pooled));
+}
+
+static std::string PooledCopy(const std::string& text)
+{
+    std::string copy = AcquireText(text.size());
+    copy.assign(text);
+    return copy;
+}
+
+// Scoped copy that goes back to the pool with the function that made it
+struct PooledText
+{
+    std::string text;
+
+    explicit PooledText(const size_t bytes) : text(AcquireText(bytes)) {}
+    ~PooledText() { ReleaseText(std::move(text)); }
+
+    PooledText(const PooledText&) = delete;
+    PooledText& operator=(const PooledText&) = delete;
+};
+
+static size_t WriterQueueDepth();
+void CALLBACK PoolTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+// UI thread, after a tick: check back once the pool could have gone idle
+static void ArmPoolTrim()
+{
+    if (g_poolTimerId) return;
+
+    bool held = false;
+    {
+        std::lock_guard<std::mutex> lock(g_poolLock);
+        held = !g_pool.empty();
+    }
+    if (held || WriterQueueDepth()) g_poolTimerId = SetTimer(nullptr, 0, kPoolIdleMs, PoolTimerProc);
+}
+
+static void StopPoolTimer()
+{
+    if (!g_poolTimerId) return;
+    KillTimer(nullptr, g_poolTimerId);
+    g_poolTimerId = 0;
+}
+
+void CALLBACK PoolTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    StopPoolTimer();
+
+    std::vector<std::string> drop;
+    DWORD recheckMs = 0;
+    {
+        std::lock_guard<std::mutex> lock(g_poolLock);
+        const ULONGLONG idle = GetTickCount64() - g_poolLastUse;
+
+        if (idle >= kPoolIdleMs)
+        {
+            drop.swap(g_pool);
+            g_poolBytes = 0;
+            g_poolRecentMax = 0;
+        }
+        else
+        {
+            recheckMs = (DWORD)(kPoolIdleMs - idle);
+        }
+    }
+
+    // Writers still hold copies that come back to the pool when they finish
+    if (!recheckMs && WriterQueueDepth()) recheckMs = kPoolIdleMs;
+    if (recheckMs) g_poolTimerId = SetTimer(nullptr, 0, recheckMs, PoolTimerProc);
+
+    NotifyDebugChanged();
+}
+
+// ================================
+// Document Access
+// ================================
+static bool ReadViewText(const HWND hSci, std::string& out)
+{
+    const LRESULT len = SendMessageW(hSci, SCI_GETLENGTH, 0, 0);
+    if (len <= 0)
+    {
+        out.clear();
+        return len == 0;
+    }
+
+    // Moves the gap once, then exposes the whole document contiguously
+    const char* text = reinterpret_cast<const char*>(SendMessageW(hSci, SCI_GETCHARACTERPOINTER, 0, 0));
+    if (!text) return false;
+
+    ReserveText(out, (size_t)len);
+    out.assign(text, (size_t)len);
+    return true;
+}
+
+static HWND EnsureReaderView()
+{
+    if (g_hSciReader || !g_hNppWnd) return g_hSciReader;
+
+    g_hSciReader = (HWND)SendMessageW(g_hNppWnd, NPPM_CREATESCINTILLAHANDLE, 0, 0);
+    if (!g_hSciReader) return nullptr;
+
+    // Keep the reader's own empty document alive so it can be swapped back in
+    g_readerBlankDoc = SendMessageW(g_hSciReader, SCI_GETDOCPOINTER, 0, 0);
+    SendMessageW(g_hSciReader, SCI_ADDREFDOCUMENT, 0, g_readerBlankDoc);
+    return g_hSciReader;
+}
+
+static void ReleaseReaderView()
+{
+    if (!g_hSciReader) return;
+
+    SendMessageW(g_hSciReader, SCI_SETDOCPOINTER, 0, g_readerBlankDoc);
+    SendMessageW(g_hSciReader, SCI_RELEASEDOCUMENT, 0, g_readerBlankDoc);
+
+    // Notepad++ owns and destroys the window itself
+    g_hSciReader = nullptr;
+    g_readerBlankDoc = 0;
+}
+
+// Copy a buffer's text on the UI thread. Visible buffers are read from their
+// view; hidden ones are briefly attached to the private reader view.
+static bool ReadBufferText(const UINT_PTR id, std::string& out)
+{
+    if (id == g_viewBuffer[MAIN_VIEW] && g_hSciMain) return ReadViewText(g_hSciMain, out);
+    if (id == g_viewBuffer[SUB_VIEW] && g_hSciSecond) return ReadViewText(g_hSciSecond, out);
+
+    const BufferEntry* e = FindBuffer(id);
+    if (!e || !e->doc) return false;
+
+    const HWND reader = EnsureReaderView();
+    if (!reader) return false;
+
+    SendMessageW(reader, SCI_SETDOCPOINTER, 0, e->doc);
+    const bool ok = ReadViewText(reader, out);
+    SendMessageW(reader, SCI_SETDOCPOINTER, 0, g_readerBlankDoc);
+    return ok;
+}
+
+// ================================
+// Content Hash
+// ================================
+// XXH64: four independent 64-bit lanes per 32-byte stripe keep the multiply
+// pipelines busy and let the compiler interleave them.
+static constexpr uint64_t kXxP1 = 11400714785074694791ull;
+static constexpr uint64_t kXxP2 = 14029467366897019727ull;
+static constexpr uint64_t kXxP3 = 1609587929392839161ull;
+static constexpr uint64_t kXxP4 = 9650029242287828579ull;
+static constexpr uint64_t kXxP5 = 2870177450012600261ull;
+
+static inline uint64_t XxRotl(const uint64_t x, const int r) { return (x << r) | (x >> (64 - r)); }
+
+static inline uint64_t XxRead64(const unsigned char* p)
+{
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t XxRead32(const unsigned char* p)
+{
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t XxRound(uint64_t acc, const uint64_t input)
+{
+    acc += input * kXxP2;
+    acc = XxRotl(acc, 31);
+    return acc * kXxP1;
+}
+
+static inline uint64_t XxMerge(uint64_t acc, const uint64_t val)
+{
+    acc ^= XxRound(0, val);
+    return acc * kXxP1 + kXxP4;
+}
+
+static uint64_t Xxh64(const void* data, const size_t len, const uint64_t seed = 0)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* const end = p + len;
+    uint64_t h;
+
+    if (len >= 32)
+    {
+        const unsigned char* const limit = end - 32;
+        uint64_t v1 = seed + kXxP1 + kXxP2;
+        uint64_t v2 = seed + kXxP2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kXxP1;
+
+        do
+        {
+            v1 = XxRound(v1, XxRead64(p));
+            v2 = XxRound(v2, XxRead64(p + 8));
+            v3 = XxRound(v3, XxRead64(p + 16));
+            v4 = XxRound(v4, XxRead64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = XxRotl(v1, 1) + XxRotl(v2, 7) + XxRotl(v3, 12) + XxRotl(v4, 18);
+        h = XxMerge(h, v1);
+        h = XxMerge(h, v2);
+        h = XxMerge(h, v3);
+        h = XxMerge(h, v4);
+    }
+    else
+    {
+        h = seed + kXxP5;
+    }
+
+    h += (uint64_t)len;
+
+    for (; p + 8 <= end; p += 8)
+    {
+        h ^= XxRound(0, XxRead64(p));
+        h = XxRotl(h, 27) * kXxP1 + kXxP4;
+    }
+    if (p + 4 <= end)
+    {
+        h ^= (uint64_t)XxRead32(p) * kXxP1;
+        h = XxRotl(h, 23) * kXxP2 + kXxP3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+    {
+        h ^= (uint64_t)(*p) * kXxP5;
+        h = XxRotl(h, 11) * kXxP1;
+    }
+
+    h ^= h >> 33;
+    h *= kXxP2;
+    h ^= h >> 29;
+    h *= kXxP3;
+    h ^= h >> 32;
+    return h;
+}
+
+// Hash a view's document in place through the character pointer (no copy)
+static bool HashViewText(const HWND hSci, uint64_t& hash, uint64_t& length)
+{
+    const LRESULT len = SendMessageW(hSci, SCI_GETLENGTH, 0, 0);
+    if (len < 0) return false;
+
+    const char* text = len ? reinterpret_cast<const char*>(SendMessageW(hSci, SCI_GETCHARACTERPOINTER, 0, 0)) : "";
+    if (!text) return false;
+
+    length = (uint64_t)len;
+    hash = Xxh64(text, (size_t)len);
+    return true;
+}
+
+static bool HashBufferText(const UINT_PTR id, uint64_t& hash, uint64_t& length)
+{
+    if (id == g_viewBuffer[MAIN_VIEW] && g_hSciMain) return HashViewText(g_hSciMain, hash, length);
+    if (id == g_viewBuffer[SUB_VIEW] && g_hSciSecond) return HashViewText(g_hSciSecond, hash, length);
+
+    const BufferEntry* e = FindBuffer(id);
+    if (!e || !e->doc) return false;
+
+    const HWND reader = EnsureReaderView();
+    if (!reader) return false;
+
+    SendMessageW(reader, SCI_SETDOCPOINTER, 0, e->doc);
+    const bool ok = HashViewText(reader, hash, length);
+    SendMessageW(reader, SCI_SETDOCPOINTER, 0, g_readerBlankDoc);
+    return ok;
+}
+
+// Buffer text now equals its file (opened clean or just saved)
+static void RecordSavedHash(const UINT_PTR id)
+{
+    uint64_t hash = 0, length = 0, diskSize = 0, diskTime = 0;
+    const std::wstring path = GetBufferPath(id);
+
+    BufferEntry& e = TouchBuffer(id);
+    e.savedHashKnown = IsNamedPath(path) && HashBufferText(id, hash, length) && GetDiskStamp(path, diskSize, diskTime);
+    e.matchesSaved = e.savedHashKnown;
+    e.savedHash = hash;
+    e.savedLength = length;
+    e.savedDiskSize = diskSize;
+    e.savedDiskTime = diskTime;
+}
+
+// True when a dirty buffer's text hashes back to what is on disk. The file
+// stamp is re-checked so an external change on disk is never masked.
+static bool ContentMatchesSaved(const UINT_PTR id, const std::wstring& path)
+{
+    BufferEntry* e = FindBuffer(id);
+    if (!e || !e->savedHashKnown) return false;
+
+    if (!e->matchesSaved)
+    {
+        uint64_t hash = 0, length = 0;
+        if (!HashBufferText(id, hash, length)) return false;
+        if (length != e->savedLength || hash != e->savedHash) return false;
+    }
+
+    uint64_t diskSize = 0, diskTime = 0;
+    if (!GetDiskStamp(path, diskSize, diskTime) || diskSize != e->savedDiskSize || diskTime != e->savedDiskTime)
+    {
+        e->savedHashKnown = false;
+        return false;
+    }
+
+    e->matchesSaved = true;
+    return true;
+}
+
+// Tell Scintilla the visible document is back at its savepoint; Notepad++
+// then clears the tab's modified state without writing anything. A hidden
+// buffer has no view to notify, so it is marked clean here; activating it
+// re-reads SCI_GETMODIFY and re-marks it dirty for the visible path.
+static void MarkVisibleSavepoint(const UINT_PTR id)
+{
+    if (id == g_viewBuffer[MAIN_VIEW] && g_hSciMain) SendMessageW(g_hSciMain, SCI_SETSAVEPOINT, 0, 0);
+    else if (id == g_viewBuffer[SUB_VIEW] && g_hSciSecond) SendMessageW(g_hSciSecond, SCI_SETSAVEPOINT, 0, 0);
+    else SetBufferDirty(id, false);
+}
+
+// ================================
+// File Helpers
+// ================================
+// Little-endian fields for the plugin's own binary files
+static void PutU8(std::string& out, const uint8_t v) { out.push_back((char)v); }
+
+static void PutU32(std::string& out, const uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) out.push_back((char)((v >> (i * 8)) & 0xFF));
+}
+
+static void PutU64(std::string& out, const uint64_t v)
+{
+    for (int i = 0; i < 8; ++i) out.push_back((char)((v >> (i * 8)) & 0xFF));
+}
+
+static bool GetU32(const std::string& in, size_t& at, uint32_t& v)
+{
+    if (in.size() - at < 4 || at > in.size()) return false;
+    v = 0;
+    for (int i = 0; i < 4; ++i) v |= (uint32_t)(uint8_t)in[at + (size_t)i] << (i * 8);
+    at += 4;
+    return true;
+}
+
+static bool GetU64(const std::string& in, size_t& at, uint64_t& v)
+{
+    if (in.size() - at < 8 || at > in.size()) return false;
+    v = 0;
+    for (int i = 0; i < 8; ++i) v |= (uint64_t)(uint8_t)in[at + (size_t)i] << (i * 8);
+    at += 8;
+    return true;
+}
+
+static bool ReadWholeFile(const std::wstring& path, std::string& out)
+{
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+        OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    LARGE_INTEGER size{};
+    bool ok = GetFileSizeEx(h, &size) != FALSE && size.QuadPart >= 0;
+    if (ok)
+    {
+        ReserveText(out, (size_t)size.QuadPart);
+        out.resize((size_t)size.QuadPart);
+
+        size_t offset = 0;
+        while (ok && offset < out.size())
+        {
+            const size_t left = out.size() - offset;
+            DWORD got = 0;
+            ok = ReadFile(h, &out[offset], (DWORD)((left > 0x40000000u) ? 0x40000000u : left), &got, nullptr) && got > 0;
+            offset += got;
+        }
+    }
+
+    CloseHandle(h);
+    return ok;
+}
+
+// A fixed-size file mapped whole
+struct MappedFile
+{
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE map = nullptr;
+    BYTE*  view = nullptr;
+
+    // Writable opens create or extend the file to size
+    bool Open(const std::wstring& path, const size_t size, const bool writable)
+    {
+        file = writable
+            ? CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr)
+            : CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+
+        if (!writable)
+        {
+            LARGE_INTEGER have{};
+            if (!GetFileSizeEx(file, &have) || (uint64_t)have.QuadPart < size) return false;
+        }
+
+        map = CreateFileMappingW(file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, (DWORD)size, nullptr);
+        if (!map) return false;
+
+        view = (BYTE*)MapViewOfFile(map, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+        return view != nullptr;
+    }
+
+    void Close()
+    {
+        if (view) UnmapViewOfFile(view);
+        if (map) CloseHandle(map);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+
+        view = nullptr;
+        map = nullptr;
+        file = INVALID_HANDLE_VALUE;
+    }
+
+    ~MappedFile() { Close(); }
+};
+
+// ================================
+// ETW Tracing
+// ================================
+// TraceLogging provider "AutoDaveSave". Its GUID is the one derived from the
+// name, so WPR profiles and tracelog can enable it as *AutoDaveSave:
+//   TickFired / TickSkipped   a deadline or typing pause came due (or could not run)
+//   Tick        start/stop    one save pass: buffers considered, results, UI time
+//   Save        start/stop    one file saved through Notepad++, bytes and duration
+//   SaveSkipped               a buffer passed over, with the reason
+//   SnapshotQueued, WriterJob background copies handed off and written
+// While no session listens, each event costs one enabled check.
+TRACELOGGING_DEFINE_PROVIDER(g_etwProvider, "AutoDaveSave",
+    (0x943c8627, 0xb259, 0x557f, 0xe8, 0xc1, 0x24, 0x83, 0x6c, 0x8b, 0x4f, 0x59));
+
+static bool g_etwRegistered = false;
+
+static const wchar_t* const kSkipReasons[] = { L"untitled", L"unchanged", L"other instance", L"throttled", L"writer busy", L"clean" };
+
+static void StartTracing()
+{
+    if (!g_etwRegistered) g_etwRegistered = SUCCEEDED(TraceLoggingRegister(g_etwProvider));
+}
+
+// DLL unload: a registered provider must not outlive the module
+static void StopTracing()
+{
+    if (g_etwRegistered) TraceLoggingUnregister(g_etwProvider);
+    g_etwRegistered = false;
+}
+
+// ================================
+// Telemetry Ring
+// ================================
+// Save events from the UI thread and the writer workers land in one fixed
+// ring that never blocks a producer. A producer claims an index with one
+// atomic add and publishes the slot with a per-slot sequence (odd while it
+// is being filled). Readers copy a slot and keep it only if the sequence
+// was the same, even value before and after, so a slot being overwritten is
+// skipped rather than waited on. The newest events win; old ones drop off.
+struct TelemetryEvent
+{
+    enum Kind : uint32_t { SaveStarted, SaveFinished, SaveSkipped, SaveFailed };
+    enum Source : uint32_t { FileSave, Snapshot, Writer };
+    enum Skip : uint32_t { Untitled, Unchanged, OtherInstance, Throttled, Backpressure, Clean };
+
+    uint32_t kind = SaveStarted;
+    uint32_t source = FileSave;
+    uint32_t detail = 0;        // Error code when failed, Skip reason when skipped
+    float    ms = 0;            // Duration when finished
+    uint64_t time = 0;          // UTC FILETIME
+    uint64_t bytes = 0;
+    wchar_t  path[MAX_PATH] = {};
+};
+
+// The event is copied in and out word by word through atomics, so a reader
+// overlapping a writer sees a torn copy (rejected by seq) but never races
+static constexpr size_t kTelemetryWords = sizeof(TelemetryEvent) / sizeof(uint64_t);
+static_assert(sizeof(TelemetryEvent) % sizeof(uint64_t) == 0, "telemetry event layout");
+static_assert(std::is_trivially_copyable<TelemetryEvent>::value, "telemetry event layout");
+
+struct TelemetrySlot
+{
+    std::atomic<uint64_t> seq{ 0 };     // 2n+1 while event n is written, 2n+2 once complete
+    std::atomic<uint64_t> words[kTelemetryWords];
+};
+
+static constexpr size_t kTelemetrySlots = 128;
+static TelemetrySlot g_telemetry[kTelemetrySlots];
+static std::atomic<uint64_t> g_telemetryHead{ 0 };
+
+// Any thread. Producers one lap apart (kTelemetrySlots events) map to the
+// same slot; only the one that moves seq forward from an even value writes
+// it. A producer that finds the slot claimed, or already holding a later
+// lap, drops its event, which then reads as missing rather than torn.
+static void StoreTelemetry(const uint64_t n, const TelemetryEvent& ev)
+{
+    TelemetrySlot& slot = g_telemetry[n % kTelemetrySlots];
+
+    uint64_t cur = slot.seq.load(std::memory_order_relaxed);
+    if ((cur & 1) || cur > 2 * n) return;
+    if (!slot.seq.compare_exchange_strong(cur, 2 * n + 1, std::memory_order_acquire, std::memory_order_relaxed)) return;
+    std::atomic_thread_fence(std::memory_order_release);
+
+    uint64_t words[kTelemetryWords];
+    memcpy(words, &ev, sizeof(words));
+    for (size_t i = 0; i < kTelemetryWords; ++i)
+        slot.words[i].store(words[i], std::memory_order_relaxed);
+
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+}
+
+static void PushTelemetry(const uint32_t kind, const uint32_t source, const std::wstring& path,
+    const uint64_t bytes = 0, const uint32_t detail = 0, const double ms = 0)
+{
+    const uint64_t n = g_telemetryHead.fetch_add(1, std::memory_order_relaxed);
+
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+
+    TelemetryEvent ev;
+    ev.kind = kind;
+    ev.source = source;
+    ev.detail = detail;
+    ev.ms = (float)ms;
+    ev.time = ((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime;
+    ev.bytes = bytes;
+    wcsncpy_s(ev.path, path.c_str(), _TRUNCATE);
+
+    StoreTelemetry(n, ev);
+    NotifyDebugChanged();
+
+    // The same event for ETW sessions, in the shape WPA pairs up
+    const uint64_t err = (kind == TelemetryEvent::SaveFailed) ? detail : 0;
+    if (kind == TelemetryEvent::SaveSkipped)
+    {
+        TraceLoggingWrite(g_etwProvider, "SaveSkipped", TraceLoggingLevel(WINEVENT_LEVEL_VERBOSE),
+            TraceLoggingWideString(path.c_str(), "Path"), TraceLoggingWideString(kSkipReasons[detail], "Reason"));
+    }
+    else if (source == TelemetryEvent::FileSave && kind == TelemetryEvent::SaveStarted)
+    {
+        TraceLoggingWrite(g_etwProvider, "Save", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+            TraceLoggingWideString(path.c_str(), "Path"));
+    }
+    else if (source == TelemetryEvent::FileSave)
+    {
+        TraceLoggingWrite(g_etwProvider, "Save", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+            TraceLoggingWideString(path.c_str(), "Path"), TraceLoggingUInt64(bytes, "Bytes"),
+            TraceLoggingFloat32((float)ms, "DurationMs"), TraceLoggingUInt32((uint32_t)err, "Error"));
+    }
+    else
+    {
+        TraceLoggingWrite(g_etwProvider, source == TelemetryEvent::Snapshot ? "SnapshotQueued" : "WriterJob",
+            TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(path.c_str(), "Path"),
+            TraceLoggingUInt64(bytes, "Bytes"), TraceLoggingFloat32((float)ms, "DurationMs"), TraceLoggingUInt32((uint32_t)err, "Error"));
+    }
+}
+
+// Newest first, up to max events that match
+template <typename Match>
+static size_t ReadTelemetry(std::vector<TelemetryEvent>& out, const size_t max, Match match)
+{
+    out.clear();
+    const uint64_t head = g_telemetryHead.load(std::memory_order_acquire);
+
+    for (uint64_t n = head; n > 0 && head - n < kTelemetrySlots && out.size() < max; --n)
+    {
+        const TelemetrySlot& slot = g_telemetry[(n - 1) % kTelemetrySlots];
+        const uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if (before != 2 * (n - 1) + 2) continue;
+
+        uint64_t words[kTelemetryWords];
+        for (size_t i = 0; i < kTelemetryWords; ++i)
+            words[i] = slot.words[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != before) continue;
+
+        TelemetryEvent ev;
+        memcpy(&ev, words, sizeof(ev));
+
+        if (match(ev)) out.push_back(ev);
+    }
+    return out.size();
+}
+
+template <typename Match>
+static bool LatestTelemetry(TelemetryEvent& ev, Match match)
+{
+    std::vector<TelemetryEvent> one;
+    if (!ReadTelemetry(one, 1, match)) return false;
+    ev = one.front();
+    return true;
+}
+
+// ================================
+// Background Writer
+// ================================
+struct WriteJob
+{
+    enum Kind { Replace, Append, Remove, Version, CloneVersion };
+
+    Kind         kind = Replace;
+    std::wstring target;   // Destination file (history index for versions)
+    std::string  data;     // Document bytes captured on the UI thread
+
+    // CloneVersion: the saved file, the text it should hold and the
+    // last-write time the save left on it
+    std::wstring source;
+    uint64_t     hash = 0;
+    uint64_t     size = 0;
+    uint64_t     diskTime = 0;
+
+    // Recovery index entry this job updates (snapshots also fill hash/size)
+    uint32_t     recovery = 0;
+    uint64_t     recoveryKey = 0;
+
+    // Volume of target and how many workers may write to it at once
+    std::wstring volume;
+    uint32_t     slots = 1;
+};
+
+static std::mutex g_writerLock;
+static std::condition_variable g_writerWake;
+static std::deque<WriteJob> g_writerQueue;
+static std::vector<std::thread> g_writerThreads;
+static bool g_writerStop = false;
+static bool g_writerClosed = false;   // StopWriter ran; no new workers, guarded by g_writerLock
+static std::vector<std::wstring> g_writerActive;   // Targets being written, guarded by g_writerLock
+static std::wstring g_recoveryPath;       // Recovery index, set at NPPN_READY, guarded by g_writerLock
+static MappedFile g_recoveryIndex;        // Writable view, guarded by g_writerLock
+
+// Version jobs share the chunk pack cache; one worker at a time stores them
+static std::mutex g_historyLock;
+
+// Jobs taken per wake. Replacements in one batch are all written before the
+// first is flushed, so each FlushFileBuffers finds lazy writeback already
+// under way for the rest. Every file is still flushed on its own: a single
+// volume flush needs administrator rights and waits for every other
+// process's dirty data on that drive as well.
+static constexpr size_t kWriteBatchMax = 64;
+
+// Workers fan out over a shared queue. Each volume admits as many at once as
+// it has slots: NVMe takes overlapping writes well, a SATA SSD less so, and a
+// spinning disk, removable drive or share only seeks or queues behind one.
+static constexpr size_t   kWriterThreads = 4;
+static constexpr uint32_t kSlotsNvme = 4;
+static constexpr uint32_t kSlotsSsd = 2;
+static constexpr uint32_t kSlotsSerial = 1;
+
+struct VolumeSlots
+{
+    std::wstring volume;
+    uint32_t     slots = kSlotsSerial;  // UI thread: probed once per volume
+    uint32_t     writers = 0;           // Workers on it now, guarded by g_writerLock
+};
+
+static std::vector<VolumeSlots> g_volumeSlots;     // UI thread
+static std::vector<VolumeSlots> g_writerVolumes;   // Guarded by g_writerLock
+
+static uint32_t ProbeVolumeSlots(const std::wstring& volume)
+{
+    if (volume.size() != 2 || volume[1] != L':') return kSlotsSerial;
+    if (GetDriveTypeW((volume + L"\\").c_str()) != DRIVE_FIXED) return kSlotsSerial;
+
+    // Storage property queries need no access rights on the volume handle
+    const std::wstring device = L"\\\\.\\" + volume;
+    HANDLE h = CreateFileW(device.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, 0, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return kSlotsSerial;
+
+    STORAGE_PROPERTY_QUERY query{};
+    query.PropertyId = StorageDeviceSeekPenaltyProperty;
+    query.QueryType = PropertyStandardQuery;
+
+    DEVICE_SEEK_PENALTY_DESCRIPTOR seek{};
+    DWORD got = 0;
+    uint32_t slots = kSlotsSerial;
+    if (DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &seek, sizeof(seek), &got, nullptr)
+        && got >= sizeof(seek) && !seek.IncursSeekPenalty)
+    {
+        query.PropertyId = StorageDeviceProperty;
+        STORAGE_DEVICE_DESCRIPTOR device{};
+        const bool nvme = DeviceIoControl(h, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query), &device, sizeof(device), &got, nullptr)
+            && got >= offsetof(STORAGE_DEVICE_DESCRIPTOR, RawPropertiesLength) && device.BusType == BusTypeNvme;
+        slots = nvme ? kSlotsNvme : kSlotsSsd;
+    }
+
+    CloseHandle(h);
+    return slots;
+}
+
+static uint32_t VolumeWriteSlots(const std::wstring& volume)
+{
+    for (const VolumeSlots& v : g_volumeSlots)
+        if (_wcsicmp(v.volume.c_str(), volume.c_str()) == 0) return v.slots;
+
+    VolumeSlots v;
+    v.volume = volume;
+    v.slots = ProbeVolumeSlots(volume);
+    g_volumeSlots.push_back(v);
+    return v.slots;
+}
+
+static DWORD WriteAll(HANDLE h, const std::string& data)
+{
+    size_t offset = 0;
+    while (offset < data.size())
+    {
+        const size_t left = data.size() - offset;
+        const DWORD chunk = (DWORD)((left > 0x40000000u) ? 0x40000000u : left);
+
+        DWORD written = 0;
+        if (!WriteFile(h, data.data() + offset, chunk, &written, nullptr))
+            return GetLastError();
+        offset += written;
+    }
+    return ERROR_SUCCESS;
+}
+
+static DWORD AppendToFile(const std::wstring& target, const std::string& data)
+{
+    HANDLE h = CreateFileW(target.c_str(), FILE_APPEND_DATA, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return GetLastError();
+
+    const DWORD err = WriteAll(h, data);
+    CloseHandle(h);
+    return err;
+}
+
+// Replacement in progress: the new bytes sit in "<target>.tmp" until swapped in
+struct StagedWrite
+{
+    HANDLE       h = INVALID_HANDLE_VALUE;
+    std::wstring target;
+    std::wstring temp;
+};
+
+static DWORD StageReplace(const std::wstring& target, const std::string& data, StagedWrite& staged)
+{
+    staged.target = target;
+    staged.temp = target + L".tmp";
+    staged.h = CreateFileW(staged.temp.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (staged.h == INVALID_HANDLE_VALUE) return GetLastError();
+
+    // Size the file up front so one large write does not extend it piecemeal
+    if (data.size() >= (1u << 20))
+    {
+        FILE_END_OF_FILE_INFO eof{};
+        eof.EndOfFile.QuadPart = (LONGLONG)data.size();
+        SetFileInformationByHandle(staged.h, FileEndOfFileInfo, &eof, sizeof(eof));
+    }
+
+    const DWORD err = WriteAll(staged.h, data);
+    if (err != ERROR_SUCCESS)
+    {
+        CloseHandle(staged.h);
+        staged.h = INVALID_HANDLE_VALUE;
+        DeleteFileW(staged.temp.c_str());
+    }
+    return err;
+}
+
+// Flush, close and swap. The target is either the old or the new file, never
+// a torn mix. ReplaceFile keeps the target's attributes; a first write has no
+// target yet and is moved into place.
+static DWORD CommitReplace(StagedWrite& staged)
+{
+    DWORD err = ERROR_SUCCESS;
+    if (!FlushFileBuffers(staged.h)) err = GetLastError();
+
+    CloseHandle(staged.h);
+    staged.h = INVALID_HANDLE_VALUE;
+
+    if (err == ERROR_SUCCESS &&
+        !ReplaceFileW(staged.target.c_str(), staged.temp.c_str(), nullptr, REPLACEFILE_IGNORE_MERGE_ERRORS, nullptr, nullptr))
+    {
+        err = GetLastError();
+        if (err == ERROR_FILE_NOT_FOUND)
+        {
+            err = MoveFileExW(staged.temp.c_str(), staged.target.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)
+                ? ERROR_SUCCESS : GetLastError();
+        }
+    }
+
+    if (err != ERROR_SUCCESS) DeleteFileW(staged.temp.c_str());
+    return err;
+}
+
+static void NoteWriteResult(const DWORD err, const WriteJob& job)
+{
+    if (err == ERROR_SUCCESS)
+    {
+        ++g_writesDone;
+        PushTelemetry(TelemetryEvent::SaveFinished, TelemetryEvent::Writer, job.target, job.data.size());
+    }
+    else
+    {
+        ++g_writesFailed;
+        PushTelemetry(TelemetryEvent::SaveFailed, TelemetryEvent::Writer, job.target, job.data.size(), err);
+    }
+}
+
+static DWORD StoreVersion(const std::wstring& index, const std::string& raw);
+static DWORD StoreClonedVersion(const std::wstring& index, const std::wstring& source, uint64_t hash, uint64_t size, uint64_t diskTime);
+
+static void NoteRecovery(MappedFile& idx, const std::wstring& path, const WriteJob& job);
+
+// Under g_writerLock. Volumes are few; the list only grows.
+static uint32_t& WritersOn(const std::wstring& volume)
+{
+    for (VolumeSlots& v : g_writerVolumes)
+        if (v.volume == volume) return v.writers;
+
+    VolumeSlots v;
+    v.volume = volume;
+    g_writerVolumes.push_back(v);
+    return g_writerVolumes.back().writers;
+}
+
+static bool IsTargetActive(const std::wstring& target)
+{
+    return std::find(g_writerActive.begin(), g_writerActive.end(), target) != g_writerActive.end();
+}
+
+// Under g_writerLock: first job whose volume has a free slot and whose file
+// is not being written by another worker
+static std::deque<WriteJob>::iterator NextRunnableJob()
+{
+    return std::find_if(g_writerQueue.begin(), g_writerQueue.end(),
+        [](const WriteJob& q) { return WritersOn(q.volume) < q.slots && !IsTargetActive(q.target); });
+}
+
+static void WriterThreadMain()
+{
+    std::unique_lock<std::mutex> lock(g_writerLock);
+
+    for (;;)
+    {
+        auto next = g_writerQueue.end();
+        g_writerWake.wait(lock, [&] {
+            next = NextRunnableJob();
+            return next != g_writerQueue.end() || (g_writerStop && g_writerQueue.empty());
+        });
+
+        // Pending jobs are drained even when stopping; they are the user's backups
+        if (next == g_writerQueue.end()) break;
+
+        // Take one slot on the volume and an even share of its runnable jobs,
+        // so the other free slots get the rest
+        const std::wstring volume = next->volume;
+        uint32_t& writers = WritersOn(volume);
+        const size_t freeSlots = next->slots - writers;
+        const size_t runnable = (size_t)std::count_if(next, g_writerQueue.end(),
+            [&](const WriteJob& q) { return q.volume == volume && !IsTargetActive(q.target); });
+        const size_t share = (std::min)(kWriteBatchMax, (runnable + freeSlots - 1) / freeSlots);
+        ++writers;
+
+        // QueueWrite keeps at most one job per file, so a batch never orders
+        // two writes to the same target
+        std::vector<WriteJob> batch;
+        for (auto it = next; it != g_writerQueue.end() && batch.size() < share;)
+        {
+            if (it->volume == volume && !IsTargetActive(it->target))
+            {
+                batch.push_back(std::move(*it));
+                it = g_writerQueue.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+        for (const WriteJob& job : batch) g_writerActive.push_back(job.target);
+        const std::wstring recoveryPath = g_recoveryPath;
+
+        lock.unlock();
+        std::vector<DWORD> results(batch.size(), ERROR_SUCCESS);
+        std::vector<StagedWrite> staged(batch.size());
+
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            const WriteJob& job = batch[i];
+            if (job.kind == WriteJob::Remove)
+            {
+                if (!DeleteFileW(job.target.c_str()) && GetLastError() != ERROR_FILE_NOT_FOUND)
+                    results[i] = GetLastError();
+            }
+            else if (job.kind == WriteJob::Append)
+            {
+                results[i] = AppendToFile(job.target, job.data);
+            }
+            else if (job.kind == WriteJob::Version)
+            {
+                std::lock_guard<std::mutex> history(g_historyLock);
+                results[i] = StoreVersion(job.target, job.data);
+            }
+            else if (job.kind == WriteJob::CloneVersion)
+            {
+                std::lock_guard<std::mutex> history(g_historyLock);
+                results[i] = StoreClonedVersion(job.target, job.source, job.hash, job.size, job.diskTime);
+            }
+            else
+            {
+                results[i] = StageReplace(job.target, job.data, staged[i]);
+            }
+        }
+
+        // Lazy writeback has had the whole batch to start on these
+        for (size_t i = 0; i < batch.size(); ++i)
+            if (staged[i].h != INVALID_HANDLE_VALUE)
+                results[i] = CommitReplace(staged[i]);
+        lock.lock();
+
+        --WritersOn(volume);
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+            g_writerActive.erase(std::find(g_writerActive.begin(), g_writerActive.end(), batch[i].target));
+            NoteWriteResult(results[i], batch[i]);
+            if (results[i] == ERROR_SUCCESS) NoteRecovery(g_recoveryIndex, recoveryPath, batch[i]);
+        }
+
+        for (WriteJob& job : batch) ReleaseText(std::move(job.data));
+
+        // A slot and these targets are free again
+        g_writerWake.notify_all();
+        NotifyDebugChanged();
+    }
+}
+
+// Queue a write. A replace or remove supersedes every job still waiting for
+// the same file, and an append is merged into the last one; an append after
+// a queued remove becomes a replace with just its bytes. So the queue never
+// holds more than one job per file, which WriterThreadMain relies on to
+// batch without ordering. After StopWriter
+// jobs are refused: a worker started then would outlive the DLL.
+static void QueueWrite(WriteJob&& job)
+{
+    job.volume = VolumeOf(job.target);
+    job.slots = VolumeWriteSlots(job.volume);
+
+    {
+        std::lock_guard<std::mutex> lock(g_writerLock);
+
+        if (g_writerClosed)
+        {
+            ++g_writesFailed;
+            ReleaseText(std::move(job.data));
+            return;
+        }
+
+        auto last = std::find_if(g_writerQueue.rbegin(), g_writerQueue.rend(),
+            [&](const WriteJob& q) { return q.target == job.target; });
+
+        // Delete, then append to nothing: the file ends up holding this data
+        if (job.kind == WriteJob::Append && last != g_writerQueue.rend() && last->kind == WriteJob::Remove)
+            job.kind = WriteJob::Replace;
+
+        if (job.kind == WriteJob::Append && last != g_writerQueue.rend())
+        {
+            last->data += job.data;
+        }
+        else
+        {
+            if (job.kind != WriteJob::Append)
+            {
+                for (WriteJob& q : g_writerQueue)
+                    if (q.target == job.target) ReleaseText(std::move(q.data));
+                g_writerQueue.erase(std::remove_if(g_writerQueue.begin(), g_writerQueue.end(),
+                    [&](const WriteJob& q) { return q.target == job.target; }), g_writerQueue.end());
+            }
+            g_writerQueue.push_back(std::move(job));
+        }
+
+        if (g_writerThreads.empty())
+        {
+            g_writerStop = false;
+            const size_t cores = (std::max)(1u, std::thread::hardware_concurrency());
+            for (size_t i = 0; i < (std::min)(kWriterThreads, cores); ++i)
+                g_writerThreads.emplace_back(WriterThreadMain);
+        }
+    }
+
+    // During a tick the wake is deferred so the tick's jobs form one batch
+    if (!g_saveBusy) g_writerWake.notify_all();
+}
+
+static void WakeWriter()
+{
+    g_writerWake.notify_all();
+}
+
+// True while a job for this file is queued or being written
+static bool IsWritePending(const std::wstring& target)
+{
+    std::lock_guard<std::mutex> lock(g_writerLock);
+
+    if (IsTargetActive(target)) return true;
+    return std::any_of(g_writerQueue.begin(), g_writerQueue.end(),
+        [&](const WriteJob& q) { return q.target == target; });
+}
+
+static size_t WriterQueueDepth()
+{
+    std::lock_guard<std::mutex> lock(g_writerLock);
+    return g_writerQueue.size();
+}
+
+// Flush and join. Must not run under the loader lock (DllMain).
+static void StopWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_writerLock);
+        g_writerStop = true;
+        g_writerClosed = true;
+    }
+    g_writerWake.notify_all();
+
+    for (std::thread& t : g_writerThreads)
+        if (t.joinable()) t.join();
+    g_writerThreads.clear();
+
+    std::lock_guard<std::mutex> lock(g_writerLock);
+    g_recoveryIndex.Close();
+}
+
+// ================================
+// Version History
+// ================================
+// Each tab keeps a ring of compressed versions under History:
+//   <name>.<path hash>.adsi          fixed-size index, memory-mapped
+//   <name>.<path hash>.<slot>.adsv   one stored version per slot
+// The UI thread only copies the text; compression, rotation and the index
+// update run on the writer thread.
+static constexpr uint32_t kHistoryMagic = 0x48534441; // "ADSH"
+static constexpr uint32_t kHistoryVersion = 1;
+static constexpr uint32_t kHistorySlots = 30;
+static constexpr uint64_t kHistoryBytesMax = 64ull << 20;   // Stored bytes per tab
+static constexpr uint32_t kCodecRaw = 0;
+static constexpr uint32_t kCodecXpressHuff = 1;
+
+struct HistoryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slots;
+    uint32_t reserved;
+    uint64_t nextSeq;
+    uint64_t reserved2;
+};
+
+// seq 0 marks an empty slot; time is UTC FILETIME
+struct HistorySlot
+{
+    uint64_t seq;
+    uint64_t time;
+    uint64_t rawSize;
+    uint64_t storedSize;
+    uint64_t hash;       // XXH64 of the raw text
+    uint32_t codec;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(HistoryHeader) == 32, "history header layout");
+static_assert(sizeof(HistorySlot) == 48, "history slot layout");
+static constexpr size_t kHistoryIndexBytes = sizeof(HistoryHeader) + kHistorySlots * sizeof(HistorySlot);
+
+static std::atomic<DWORD>    g_versionsStored{ 0 };
+static std::atomic<uint64_t> g_versionRawBytes{ 0 };
+static std::atomic<uint64_t> g_versionStoredBytes{ 0 };
+static std::atomic<DWORD>    g_versionsCloned{ 0 };
+
+// Windows Compression API (cabinet.dll, Windows 8+), resolved on first use so
+// the plugin still loads without it; versions are then stored uncompressed.
+typedef BOOL(WINAPI* CreateCompressorFn)(DWORD, PCOMPRESS_ALLOCATION_ROUTINES, COMPRESSOR_HANDLE*);
+typedef BOOL(WINAPI* CompressFn)(COMPRESSOR_HANDLE, LPCVOID, SIZE_T, PVOID, SIZE_T, SIZE_T*);
+typedef BOOL(WINAPI* CloseCompressorFn)(COMPRESSOR_HANDLE);
+typedef BOOL(WINAPI* CreateDecompressorFn)(DWORD, PCOMPRESS_ALLOCATION_ROUTINES, DECOMPRESSOR_HANDLE*);
+typedef BOOL(WINAPI* DecompressFn)(DECOMPRESSOR_HANDLE, LPCVOID, SIZE_T, PVOID, SIZE_T, SIZE_T*);
+typedef BOOL(WINAPI* CloseDecompressorFn)(DECOMPRESSOR_HANDLE);
+
+struct CabinetApi
+{
+    CreateCompressorFn   createCompressor = nullptr;
+    CompressFn           compress = nullptr;
+    CloseCompressorFn    closeCompressor = nullptr;
+    CreateDecompressorFn createDecompressor = nullptr;
+    DecompressFn         decompress = nullptr;
+    CloseDecompressorFn  closeDecompressor = nullptr;
+
+    bool Usable() const
+    {
+        return createCompressor && compress && closeCompressor && createDecompressor && decompress && closeDecompressor;
+    }
+};
+
+// Shared by the writer and UI threads; the static is initialized once
+static const CabinetApi& Cabinet()
+{
+    static const CabinetApi api = [] {
+        CabinetApi a;
+        HMODULE dll = LoadLibraryExW(L"cabinet.dll", nullptr, LOAD_LIBRARY_SEARCH_SYSTEM32);
+        if (!dll) return a;
+
+        a.createCompressor = (CreateCompressorFn)GetProcAddress(dll, "CreateCompressor");
+        a.compress = (CompressFn)GetProcAddress(dll, "Compress");
+        a.closeCompressor = (CloseCompressorFn)GetProcAddress(dll, "CloseCompressor");
+        a.createDecompressor = (CreateDecompressorFn)GetProcAddress(dll, "CreateDecompressor");
+        a.decompress = (DecompressFn)GetProcAddress(dll, "Decompress");
+        a.closeDecompressor = (CloseDecompressorFn)GetProcAddress(dll, "CloseDecompressor");
+        return a;
+    }();
+    return api;
+}
+
+// False when compression is unavailable or does not shrink the text
+static bool CompressText(const char* raw, const size_t len, std::string& out)
+{
+    const CabinetApi& api = Cabinet();
+    if (!api.Usable() || len < 64) return false;
+
+    COMPRESSOR_HANDLE h = nullptr;
+    if (!api.createCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &h)) return false;
+
+    // The query returns a worst-case bound, usually above len, not the
+    // compressed size; compress once into it and judge by the result
+    SIZE_T needed = 0;
+    api.compress(h, raw, len, nullptr, 0, &needed);
+    out.resize((std::max)((size_t)needed, len + len / 8 + 64));
+
+    SIZE_T got = 0;
+    const bool ok = api.compress(h, raw, len, &out[0], out.size(), &got) && got < len;
+    out.resize(ok ? got : 0);
+
+    api.closeCompressor(h);
+    return ok;
+}
+
+static bool DecompressText(const std::string& stored, const uint64_t rawSize, std::string& out)
+{
+    const CabinetApi& api = Cabinet();
+    if (!api.Usable()) return false;
+
+    DECOMPRESSOR_HANDLE h = nullptr;
+    if (!api.createDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, nullptr, &h)) return false;
+
+    out.resize((size_t)rawSize);
+    SIZE_T got = 0;
+    const bool ok = api.decompress(h, stored.data(), stored.size(), out.empty() ? nullptr : &out[0], out.size(), &got) && got == rawSize;
+
+    api.closeDecompressor(h);
+    return ok;
+}
+
+static std::wstring HistoryIndexFor(const std::wstring& path)
+{
+    const std::wstring dir = PluginDataDir(L"History");
+    if (dir.empty()) return std::wstring();
+    return dir + L"\\" + StoreNameFor(path, L"adsi");
+}
+
+// "<...>.adsi" -> "<...>.07.adsv"
+static std::wstring HistorySlotPath(const std::wstring& index, const uint32_t slot)
+{
+    const std::wstring num = (slot < 10 ? L"0" : L"") + std::to_wstring(slot);
+    return index.substr(0, index.size() - 4) + num + L".adsv";
+}
+
+// Content-defined chunking: a gear rolling hash cuts the text where its low
+// bits are zero, so an edit only changes the chunks it touches and every
+// version shares the rest. Chunks live once in a per-tab pack:
+//   <name>.<path hash>.adsp   records: u32 magic "ADSC", u32 codec,
+//                             u32 raw length, u32 stored length, u64 XXH64, bytes
+// and a chunked slot file is a manifest:
+//   u32 magic "ADSM", u32 count, then count x (u64 XXH64, u32 raw length).
+static constexpr uint32_t kCodecChunked = 2;
+static constexpr uint32_t kChunkMagic = 0x43534441;     // "ADSC"
+static constexpr uint32_t kManifestMagic = 0x4D534441;  // "ADSM"
+static constexpr size_t   kChunkMin = 2u << 10;
+static constexpr size_t   kChunkMax = 64u << 10;
+static constexpr uint64_t kChunkMask = (1u << 13) - 1;  // ~8 KB average
+static constexpr size_t   kChunkRecordHeader = 24;
+static constexpr size_t   kPackCacheMax = 4;
+
+static const uint64_t* GearTable()
+{
+    static const std::vector<uint64_t> table = [] {
+        std::vector<uint64_t> t(256);
+        uint64_t x = 0x9E3779B97F4A7C15ull;
+        for (uint64_t& v : t)
+        {
+            // splitmix64
+            x += 0x9E3779B97F4A7C15ull;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            v = z ^ (z >> 31);
+        }
+        return t;
+    }();
+    return table.data();
+}
+
+// Chunk lengths covering the text, in order
+static std::vector<size_t> ChunkText(const std::string& raw)
+{
+    const uint64_t* gear = GearTable();
+    std::vector<size_t> cuts;
+
+    size_t start = 0;
+    while (start < raw.size())
+    {
+        const size_t left = raw.size() - start;
+        size_t len = (left < kChunkMax) ? left : kChunkMax;
+
+        if (left > kChunkMin)
+        {
+            uint64_t h = 0;
+            for (size_t i = kChunkMin; i < len; ++i)
+            {
+                h = (h << 1) + gear[(uint8_t)raw[start + i]];
+                if ((h & kChunkMask) == 0)
+                {
+                    len = i + 1;
+                    break;
+                }
+            }
+        }
+
+        cuts.push_back(len);
+        start += len;
+    }
+
+    return cuts;
+}
+
+struct ChunkRef
+{
+    uint64_t offset = 0;   // Of the chunk bytes, past the record header
+    uint32_t codec = 0;
+    uint32_t rawLen = 0;
+    uint32_t storedLen = 0;
+};
+
+struct ChunkPack
+{
+    std::wstring path;
+    std::unordered_map<uint64_t, ChunkRef> chunks;
+    uint64_t end = 0;      // End of the last whole record
+
+    // Chunk references, read from the manifests once per cached pack
+    bool     refsKnown = false;
+    std::unordered_map<uint64_t, uint32_t> refs;    // Slots naming each chunk
+    std::vector<uint64_t> slotChunks[kHistorySlots]; // Distinct chunks each slot names
+    uint64_t deadBytes = 0;                          // Records no slot names
+};
+
+static std::wstring HistoryPackPath(const std::wstring& index)
+{
+    return index.substr(0, index.size() - 4) + L"adsp";
+}
+
+// Index every whole record; a torn tail from a crash ends the scan
+static void ParsePack(const std::string& bytes, ChunkPack& pack)
+{
+    pack.chunks.clear();
+
+    size_t at = 0;
+    while (bytes.size() - at >= kChunkRecordHeader)
+    {
+        uint32_t magic, codec, rawLen, storedLen;
+        uint64_t hash;
+        memcpy(&magic, bytes.data() + at, 4);
+        memcpy(&codec, bytes.data() + at + 4, 4);
+        memcpy(&rawLen, bytes.data() + at + 8, 4);
+        memcpy(&storedLen, bytes.data() + at + 12, 4);
+        memcpy(&hash, bytes.data() + at + 16, 8);
+
+        if (magic != kChunkMagic || bytes.size() - at - kChunkRecordHeader < storedLen) break;
+
+        ChunkRef ref;
+        ref.offset = at + kChunkRecordHeader;
+        ref.codec = codec;
+        ref.rawLen = rawLen;
+        ref.storedLen = storedLen;
+        pack.chunks[hash] = ref;
+
+        at += kChunkRecordHeader + storedLen;
+    }
+
+    pack.end = at;
+}
+
+// Writer workers, under g_historyLock: packs of recently versioned tabs stay indexed
+static std::deque<ChunkPack> g_packCache;
+
+static ChunkPack& OpenPack(const std::wstring& path)
+{
+    auto it = std::find_if(g_packCache.begin(), g_packCache.end(), [&](const ChunkPack& p) { return p.path == path; });
+    if (it != g_packCache.end())
+    {
+        if (it != g_packCache.begin())
+        {
+            ChunkPack hit = std::move(*it);
+            g_packCache.erase(it);
+            g_packCache.push_front(std::move(hit));
+        }
+        return g_packCache.front();
+    }
+
+    if (g_packCache.size() >= kPackCacheMax) g_packCache.pop_back();
+
+    ChunkPack pack;
+    pack.path = path;
+
+    std::string bytes;
+    if (ReadWholeFile(path, bytes)) ParsePack(bytes, pack);
+
+    g_packCache.push_front(std::move(pack));
+    return g_packCache.front();
+}
+
+static void PutRecord(std::string& out, const uint32_t codec, const uint32_t rawLen, const uint64_t hash, const char* data, const size_t len)
+{
+    PutU32(out, kChunkMagic);
+    PutU32(out, codec);
+    PutU32(out, rawLen);
+    PutU32(out, (uint32_t)len);
+    PutU64(out, hash);
+    out.append(data, len);
+}
+
+// Append the chunks the pack lacks (flushed before any manifest names them)
+// and build the manifest. added counts the new pack bytes.
+static DWORD StoreChunks(ChunkPack& pack, const std::string& raw, std::string& manifest, uint64_t& added)
+{
+    const std::vector<size_t> cuts = ChunkText(raw);
+
+    manifest.clear();
+    PutU32(manifest, kManifestMagic);
+    PutU32(manifest, (uint32_t)cuts.size());
+
+    // A new file's records come close to its size; repeat versions add little
+    PooledText pooledRecords(raw.size());
+    std::string& records = pooledRecords.text;
+    std::string packed;
+    std::unordered_map<uint64_t, ChunkRef> fresh;
+
+    size_t start = 0;
+    for (const size_t len : cuts)
+    {
+        const char* chunk = raw.data() + start;
+        const uint64_t hash = Xxh64(chunk, len);
+        start += len;
+
+        PutU64(manifest, hash);
+        PutU32(manifest, (uint32_t)len);
+
+        if (pack.chunks.count(hash) || fresh.count(hash)) continue;
+
+        const bool compressed = CompressText(chunk, len, packed);
+
+        ChunkRef ref;
+        ref.codec = compressed ? kCodecXpressHuff : kCodecRaw;
+        ref.rawLen = (uint32_t)len;
+        ref.storedLen = (uint32_t)(compressed ? packed.size() : len);
+        ref.offset = pack.end + records.size() + kChunkRecordHeader;
+        fresh[hash] = ref;
+
+        if (compressed) PutRecord(records, ref.codec, ref.rawLen, hash, packed.data(), packed.size());
+        else PutRecord(records, ref.codec, ref.rawLen, hash, chunk, len);
+    }
+
+    added = records.size();
+    if (records.empty()) return ERROR_SUCCESS;
+
+    HANDLE h = CreateFileW(pack.path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return GetLastError();
+
+    // Cut any torn tail so new records follow the last whole one
+    LARGE_INTEGER pos{};
+    pos.QuadPart = (LONGLONG)pack.end;
+    DWORD err = ERROR_SUCCESS;
+    if (!SetFilePointerEx(h, pos, nullptr, FILE_BEGIN) || !SetEndOfFile(h)) err = GetLastError();
+    if (err == ERROR_SUCCESS) err = WriteAll(h, records);
+    if (err == ERROR_SUCCESS && !FlushFileBuffers(h)) err = GetLastError();
+    CloseHandle(h);
+
+    if (err != ERROR_SUCCESS) return err;
+
+    for (const auto& f : fresh) pack.chunks[f.first] = f.second;
+    pack.end += records.size();
+
+    // Named by no slot until the version's manifest is recorded
+    if (pack.refsKnown) pack.deadBytes += records.size();
+    return ERROR_SUCCESS;
+}
+
+static bool ParseManifest(const std::string& manifest, std::vector<std::pair<uint64_t, uint32_t>>& out)
+{
+    size_t at = 0;
+    uint32_t magic = 0, count = 0;
+    if (!GetU32(manifest, at, magic) || magic != kManifestMagic || !GetU32(manifest, at, count)) return false;
+
+    out.clear();
+    out.reserve(count);
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        uint64_t hash = 0;
+        uint32_t len = 0;
+        if (!GetU64(manifest, at, hash) || !GetU32(manifest, at, len)) return false;
+        out.emplace_back(hash, len);
+    }
+    return true;
+}
+
+// Chunk references: each cached pack knows which chunks every slot's
+// manifest names and how many slots name each chunk. A chunk's record
+// becomes dead when the last slot naming it is overwritten or dropped, so
+// compaction is decided without rereading manifests.
+static uint64_t ChunkRecordBytes(const ChunkPack& pack, const uint64_t hash)
+{
+    const auto it = pack.chunks.find(hash);
+    return it == pack.chunks.end() ? 0 : kChunkRecordHeader + it->second.storedLen;
+}
+
+static std::vector<uint64_t> ManifestChunks(const std::string& manifest)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> entries;
+    std::vector<uint64_t> out;
+    if (!ParseManifest(manifest, entries)) return out;
+
+    out.reserve(entries.size());
+    for (const auto& en : entries) out.push_back(en.first);
+    std::sort(out.begin(), out.end());
+    out.erase(std::unique(out.begin(), out.end()), out.end());
+    return out;
+}
+
+// Point a slot at other chunks. New references are taken before the old
+// ones go, so chunks both versions share never pass through dead.
+static void SetSlotChunks(ChunkPack& pack, const uint32_t slot, std::vector<uint64_t>&& chunks)
+{
+    for (const uint64_t h : chunks)
+        if (pack.refs[h]++ == 0) pack.deadBytes -= (std::min)(pack.deadBytes, ChunkRecordBytes(pack, h));
+
+    for (const uint64_t h : pack.slotChunks[slot])
+    {
+        const auto it = pack.refs.find(h);
+        if (it == pack.refs.end() || --it->second) continue;
+
+        pack.refs.erase(it);
+        pack.deadBytes += ChunkRecordBytes(pack, h);
+    }
+    pack.slotChunks[slot] = std::move(chunks);
+}
+
+// Writer thread: read the live manifests of a pack first used this session.
+// Every record starts out dead and is revived by the slots that name it.
+static void LoadChunkRefs(ChunkPack& pack, const std::wstring& index, const HistorySlot* slots)
+{
+    if (pack.refsKnown) return;
+
+    pack.refs.clear();
+    for (std::vector<uint64_t>& c : pack.slotChunks) c.clear();
+
+    pack.deadBytes = 0;
+    for (const auto& c : pack.chunks) pack.deadBytes += kChunkRecordHeader + c.second.storedLen;
+
+    for (uint32_t i = 0; i < kHistorySlots; ++i)
+    {
+        if (!slots[i].seq || slots[i].codec != kCodecChunked) continue;
+
+        std::string manifest;
+        if (ReadWholeFile(HistorySlotPath(index, i), manifest)) SetSlotChunks(pack, i, ManifestChunks(manifest));
+    }
+    pack.refsKnown = true;
+}
+
+// A slot of this tab's index now names other chunks (none when dropped or
+// cloned). A pack that is not cached rereads its manifests when next used.
+static void NoteSlotChunks(const std::wstring& index, const uint32_t slot, std::vector<uint64_t>&& chunks)
+{
+    const std::wstring path = HistoryPackPath(index);
+    for (ChunkPack& p : g_packCache)
+        if (p.path == path && p.refsKnown) SetSlotChunks(p, slot, std::move(chunks));
+}
+
+// The index was reset; its slots no longer name anything
+static void ForgetChunkRefs(const std::wstring& index)
+{
+    const std::wstring path = HistoryPackPath(index);
+    for (ChunkPack& p : g_packCache)
+        if (p.path == path) p.refsKnown = false;
+}
+
+// Rewrite the pack with only the chunks live slots still name, once dropped
+// versions leave more dead bytes than live ones
+static void CompactPack(ChunkPack& pack)
+{
+    if (!pack.refsKnown) return;
+
+    const uint64_t liveBytes = pack.end - (std::min)(pack.deadBytes, pack.end);
+    if (pack.end <= 2 * liveBytes + (1u << 20)) return;
+
+    std::string bytes;
+    if (!ReadWholeFile(pack.path, bytes) || bytes.size() < pack.end) return;
+
+    std::string out;
+    out.reserve((size_t)liveBytes);
+    for (const auto& c : pack.chunks)
+    {
+        if (!pack.refs.count(c.first)) continue;
+        PutRecord(out, c.second.codec, c.second.rawLen, c.first, bytes.data() + c.second.offset, c.second.storedLen);
+    }
+
+    StagedWrite staged;
+    if (StageReplace(pack.path, out, staged) != ERROR_SUCCESS || CommitReplace(staged) != ERROR_SUCCESS) return;
+
+    ParsePack(out, pack);
+    pack.deadBytes = 0;
+}
+
+// UI thread: rebuild the text from a manifest and the pack
+static bool LoadChunked(const std::wstring& index, const std::string& manifest, std::string& text)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> entries;
+    if (!ParseManifest(manifest, entries)) return false;
+
+    std::string bytes;
+    if (!ReadWholeFile(HistoryPackPath(index), bytes)) return false;
+
+    ChunkPack pack;
+    ParsePack(bytes, pack);
+
+    text.clear();
+    for (const auto& en : entries)
+    {
+        const auto it = pack.chunks.find(en.first);
+        if (it == pack.chunks.end() || it->second.rawLen != en.second) return false;
+
+        const std::string stored(bytes.data() + it->second.offset, it->second.storedLen);
+        if (it->second.codec == kCodecXpressHuff)
+        {
+            std::string chunk;
+            if (!DecompressText(stored, it->second.rawLen, chunk)) return false;
+            text += chunk;
+        }
+        else
+        {
+            text += stored;
+        }
+    }
+    return true;
+}
+
+// Writer thread: open the index (resetting a foreign or older layout) and
+// pick the empty or oldest slot for the next version
+static bool OpenHistoryIndex(const std::wstring& index, MappedFile& idx, uint32_t& pick)
+{
+    if (!idx.Open(index, kHistoryIndexBytes, true)) return false;
+
+    HistoryHeader* hdr = (HistoryHeader*)idx.view;
+    const HistorySlot* slots = (const HistorySlot*)(idx.view + sizeof(HistoryHeader));
+
+    if (hdr->magic != kHistoryMagic || hdr->version != kHistoryVersion || hdr->slots != kHistorySlots)
+    {
+        ForgetChunkRefs(index);
+        ZeroMemory(idx.view, kHistoryIndexBytes);
+        hdr->magic = kHistoryMagic;
+        hdr->version = kHistoryVersion;
+        hdr->slots = kHistorySlots;
+        hdr->nextSeq = 1;
+    }
+
+    pick = 0;
+    for (uint32_t i = 0; i < kHistorySlots; ++i)
+    {
+        if (slots[i].seq == 0) { pick = i; break; }
+        if (slots[i].seq < slots[pick].seq) pick = i;
+    }
+    return true;
+}
+
+// Point the picked slot at its committed file, then drop the oldest versions
+// until the tab fits its byte budget. The slot file always lands before the
+// index names it; a crash in between is caught by the hash on restore.
+static void RecordSlot(const std::wstring& index, MappedFile& idx, const uint32_t pick, HistorySlot filled, std::vector<uint64_t> chunks)
+{
+    HistoryHeader* hdr = (HistoryHeader*)idx.view;
+    HistorySlot* slots = (HistorySlot*)(idx.view + sizeof(HistoryHeader));
+
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+
+    filled.seq = hdr->nextSeq++;
+    filled.time = FileTimeU64(now);
+    slots[pick] = filled;
+    NoteSlotChunks(index, pick, std::move(chunks));
+
+    for (;;)
+    {
+        uint64_t total = 0;
+        int oldest = -1;
+        for (uint32_t i = 0; i < kHistorySlots; ++i)
+        {
+            if (!slots[i].seq) continue;
+            total += slots[i].storedSize;
+            if (i != pick && (oldest < 0 || slots[i].seq < slots[oldest].seq)) oldest = (int)i;
+        }
+        if (total <= kHistoryBytesMax || oldest < 0) break;
+
+        DeleteFileW(HistorySlotPath(index, (uint32_t)oldest).c_str());
+        ZeroMemory(&slots[oldest], sizeof(HistorySlot));
+        NoteSlotChunks(index, (uint32_t)oldest, {});
+    }
+
+    FlushViewOfFile(idx.view, 0);
+
+    ++g_versionsStored;
+    g_versionRawBytes += filled.rawSize;
+    g_versionStoredBytes += filled.storedSize;
+}
+
+// Writer thread: store one version as chunks plus a manifest
+static DWORD StoreVersion(const std::wstring& index, const std::string& raw)
+{
+    ChunkPack& pack = OpenPack(HistoryPackPath(index));
+
+    std::string manifest;
+    uint64_t added = 0;
+    DWORD err = StoreChunks(pack, raw, manifest, added);
+    if (err != ERROR_SUCCESS) return err;
+
+    MappedFile idx;
+    uint32_t pick = 0;
+    if (!OpenHistoryIndex(index, idx, pick)) return GetLastError();
+
+    // Before the picked slot's old manifest is replaced
+    LoadChunkRefs(pack, index, (const HistorySlot*)(idx.view + sizeof(HistoryHeader)));
+
+    StagedWrite staged;
+    err = StageReplace(HistorySlotPath(index, pick), manifest, staged);
+    if (err == ERROR_SUCCESS) err = CommitReplace(staged);
+    if (err != ERROR_SUCCESS) return err;
+
+    HistorySlot filled{};
+    filled.rawSize = raw.size();
+    filled.storedSize = manifest.size() + added;   // What this version cost on disk
+    filled.hash = Xxh64(raw.data(), raw.size());
+    filled.codec = kCodecChunked;
+    RecordSlot(index, idx, pick, filled, ManifestChunks(manifest));
+
+    CompactPack(pack);
+    return ERROR_SUCCESS;
+}
+
+// ReFS block cloning: a saved file on the same ReFS volume as the History
+// folder (a Dev Drive with a portable Notepad++, for instance) is versioned
+// by sharing its clusters instead of copying bytes. The slot holds a plain
+// copy of the file (codec 3) and costs no space until the file diverges, so
+// it counts nothing against the byte budget; the slot ring still bounds it.
+static constexpr uint32_t kCodecClone = 3;
+static constexpr uint64_t kCloneStep = 1ull << 30;   // Per FSCTL call, under the 4 GB limit
+
+static DWORD CloneExtents(HANDLE src, HANDLE dst, const uint64_t size)
+{
+    DWORD ret = 0;
+
+    // Clones require matching integrity streams, and give the cluster size
+    FSCTL_GET_INTEGRITY_INFORMATION_BUFFER info{};
+    if (!DeviceIoControl(src, FSCTL_GET_INTEGRITY_INFORMATION, nullptr, 0, &info, sizeof(info), &ret, nullptr))
+        return GetLastError();
+
+    FSCTL_SET_INTEGRITY_INFORMATION_BUFFER set{};
+    set.ChecksumAlgorithm = info.ChecksumAlgorithm;
+    set.Flags = info.Flags;
+    if (!DeviceIoControl(dst, FSCTL_SET_INTEGRITY_INFORMATION, &set, sizeof(set), nullptr, 0, &ret, nullptr))
+        return GetLastError();
+
+    FILE_END_OF_FILE_INFO eof{};
+    eof.EndOfFile.QuadPart = (LONGLONG)size;
+    if (!SetFileInformationByHandle(dst, FileEndOfFileInfo, &eof, sizeof(eof))) return GetLastError();
+
+    const uint64_t cluster = info.ClusterSizeInBytes ? info.ClusterSizeInBytes : 4096;
+    for (uint64_t at = 0; at < size; at += kCloneStep)
+    {
+        // The last range is rounded up to a whole cluster, past end of file
+        uint64_t count = (size - at < kCloneStep) ? (size - at) : kCloneStep;
+        count = (count + cluster - 1) / cluster * cluster;
+
+        DUPLICATE_EXTENTS_DATA dup{};
+        dup.FileHandle = src;
+        dup.SourceFileOffset.QuadPart = (LONGLONG)at;
+        dup.TargetFileOffset.QuadPart = (LONGLONG)at;
+        dup.ByteCount.QuadPart = (LONGLONG)count;
+        if (!DeviceIoControl(dst, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &dup, sizeof(dup), nullptr, 0, &ret, nullptr))
+            return GetLastError();
+    }
+    return ERROR_SUCCESS;
+}
+
+// Size and last-write time still those the save left on the file
+static bool StillAsSaved(const HANDLE src, const uint64_t size, const uint64_t diskTime)
+{
+    LARGE_INTEGER have{};
+    FILETIME written{};
+    return diskTime && GetFileSizeEx(src, &have) && (uint64_t)have.QuadPart == size &&
+        GetFileTime(src, nullptr, nullptr, &written) && FileTimeU64(written) == diskTime;
+}
+
+// Writer thread: version a saved file whose bytes are the buffer text.
+// The clone is only kept when the file is still as saved both before and
+// after its extents are shared, so the slot holds the hashed bytes without
+// reading them. Anything else falls back to reading the file and storing
+// chunks, which skips a file whose text no longer hashes as saved.
+static DWORD StoreClonedVersion(const std::wstring& index, const std::wstring& source, const uint64_t hash, const uint64_t size,
+    const uint64_t diskTime)
+{
+    HANDLE src = CreateFileW(source.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (src == INVALID_HANDLE_VALUE) return GetLastError();
+
+    StagedWrite staged;
+    staged.temp = index.substr(0, index.size() - 4) + L"clone.tmp";
+    staged.h = CreateFileW(staged.temp.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    bool cloned = staged.h != INVALID_HANDLE_VALUE && StillAsSaved(src, size, diskTime);
+    if (cloned)
+    {
+        DWORD serialSrc = 0, serialDst = 0, flags = 0;
+        cloned = GetVolumeInformationByHandleW(src, nullptr, 0, &serialSrc, nullptr, &flags, nullptr, 0) &&
+            GetVolumeInformationByHandleW(staged.h, nullptr, 0, &serialDst, nullptr, nullptr, nullptr, 0) &&
+            serialSrc == serialDst && (flags & FILE_SUPPORTS_BLOCK_REFCOUNTING) &&
+            CloneExtents(src, staged.h, size) == ERROR_SUCCESS && StillAsSaved(src, size, diskTime);
+    }
+    CloseHandle(src);
+
+    if (!cloned)
+    {
+        if (staged.h != INVALID_HANDLE_VALUE)
+        {
+            CloseHandle(staged.h);
+            DeleteFileW(staged.temp.c_str());
+        }
+
+        PooledText raw((size_t)size);
+        if (!ReadWholeFile(source, raw.text)) return GetLastError();
+        if (raw.text.size() != size || Xxh64(raw.text.data(), raw.text.size()) != hash) return ERROR_SUCCESS;
+        return StoreVersion(index, raw.text);
+    }
+
+    MappedFile idx;
+    uint32_t pick = 0;
+    if (!OpenHistoryIndex(index, idx, pick))
+    {
+        const DWORD err = GetLastError();
+        CloseHandle(staged.h);
+        DeleteFileW(staged.temp.c_str());
+        return err;
+    }
+
+    staged.target = HistorySlotPath(index, pick);
+    const DWORD err = CommitReplace(staged);
+    if (err != ERROR_SUCCESS) return err;
+
+    HistorySlot filled{};
+    filled.rawSize = size;
+    filled.storedSize = 0;   // Shares the file's clusters; outside the byte budget, bounded by the slot ring
+    filled.hash = hash;
+    filled.codec = kCodecClone;
+    RecordSlot(index, idx, pick, filled, {});
+
+    ++g_versionsCloned;
+    return ERROR_SUCCESS;
+}
+
+// Live slots, newest first
+static std::vector<HistorySlot> ReadHistoryIndex(const std::wstring& index)
+{
+    std::vector<HistorySlot> out;
+
+    MappedFile idx;
+    if (!idx.Open(index, kHistoryIndexBytes, false)) return out;
+
+    const HistoryHeader* hdr = (const HistoryHeader*)idx.view;
+    if (hdr->magic != kHistoryMagic || hdr->version != kHistoryVersion || hdr->slots != kHistorySlots) return out;
+
+    const HistorySlot* slots = (const HistorySlot*)(idx.view + sizeof(HistoryHeader));
+    for (uint32_t i = 0; i < kHistorySlots; ++i)
+    {
+        if (!slots[i].seq) continue;
+        out.push_back(slots[i]);
+        out.back().reserved = i;   // Slot number, for the data file name
+    }
+
+    std::sort(out.begin(), out.end(), [](const HistorySlot& a, const HistorySlot& b) { return a.seq > b.seq; });
+    return out;
+}
+
+static bool LoadVersion(const std::wstring& index, const HistorySlot& slot, std::string& text)
+{
+    std::string stored;
+    if (!ReadWholeFile(HistorySlotPath(index, slot.reserved), stored)) return false;
+
+    if (slot.codec == kCodecChunked)
+    {
+        if (!LoadChunked(index, stored, text)) return false;
+    }
+    else if (slot.codec == kCodecXpressHuff)
+    {
+        if (!DecompressText(stored, slot.rawSize, text)) return false;
+    }
+    else
+    {
+        text.swap(stored);
+    }
+
+    return text.size() == slot.rawSize && Xxh64(text.data(), text.size()) == slot.hash;
+}
+
+// UI thread: hand a copy of the text to the writer unless it matches the
+// last version taken for this tab
+static void QueueVersion(BufferEntry& e, const std::wstring& path, std::string&& text, const uint64_t hash)
+{
+    WriteJob job;
+    job.kind = WriteJob::Version;
+    job.target = (e.histHashKnown && e.histHash == hash) ? std::wstring() : HistoryIndexFor(path);
+    if (job.target.empty())
+    {
+        ReleaseText(std::move(text));
+        return;
+    }
+
+    job.data = std::move(text);
+    QueueWrite(std::move(job));
+
+    e.histHashKnown = true;
+    e.histHash = hash;
+}
+
+static bool DiskBaseBomBytes(const UINT_PTR id, uint32_t& bom);
+
+// True when a file here and the History folder share a volume that can
+// clone blocks; cached per volume root
+static bool CanCloneIntoHistory(const std::wstring& path)
+{
+    static std::vector<std::pair<std::wstring, bool>> cache;
+
+    wchar_t root[MAX_PATH] = {};
+    if (!GetVolumePathNameW(path.c_str(), root, MAX_PATH)) return false;
+
+    for (const auto& c : cache)
+        if (_wcsicmp(c.first.c_str(), root) == 0) return c.second;
+
+    bool ok = false;
+    const std::wstring dir = PluginDataDir(L"History");
+    wchar_t histRoot[MAX_PATH] = {};
+    DWORD flags = 0;
+    if (!dir.empty() && GetVolumePathNameW(dir.c_str(), histRoot, MAX_PATH) && _wcsicmp(root, histRoot) == 0 &&
+        GetVolumeInformationW(root, nullptr, 0, nullptr, nullptr, &flags, nullptr, 0))
+        ok = (flags & FILE_SUPPORTS_BLOCK_REFCOUNTING) != 0;
+
+    cache.emplace_back(root, ok);
+    return ok;
+}
+
+// Saved and byte-identical on disk (8-bit, no BOM): let the writer clone
+// the file instead of copying the text off the UI thread
+static bool QueueClonedVersion(BufferEntry& e, const std::wstring& path)
+{
+    uint32_t bom = 0;
+    if (e.dirty || !e.savedHashKnown || e.savedDiskSize != e.savedLength) return false;
+    if (!IsNamedPath(path) || !DiskBaseBomBytes(e.id, bom) || bom != 0 || !CanCloneIntoHistory(path)) return false;
+
+    if (e.histHashKnown && e.histHash == e.savedHash) return true;
+
+    WriteJob job;
+    job.kind = WriteJob::CloneVersion;
+    job.target = HistoryIndexFor(path);
+    if (job.target.empty()) return false;
+
+    job.source = path;
+    job.hash = e.savedHash;
+    job.size = e.savedLength;
+    job.diskTime = e.savedDiskTime;
+    QueueWrite(std::move(job));
+
+    e.histHashKnown = true;
+    e.histHash = e.savedHash;
+    return true;
+}
+
+// Save mode: the due buffers were saved by Notepad++, so read them here
+static void CaptureHistory(const std::vector<UINT_PTR>& ids)
+{
+    for (const UINT_PTR id : ids)
+    {
+        BufferEntry* e = FindBuffer(id);
+        if (!e) continue;
+
+        const std::wstring path = GetBufferPath(id);
+        if (QueueClonedVersion(*e, path)) continue;
+
+        std::string text;
+        if (!ReadBufferText(id, text)) continue;
+
+        const uint64_t hash = Xxh64(text.data(), text.size());
+        QueueVersion(TouchBuffer(id), path, std::move(text), hash);
+    }
+}
+
+// ================================
+// Recovery Index
+// ================================
+// One fixed-size table, recovery.adsr, maps a path hash to what the writer
+// last left on disk for it: a journal and/or a backup snapshot with the
+// hash of its text. Startup maps it read-only instead of walking the
+// Journal and Backup folders, and each tab is checked the first time it is
+// shown. Only entries written before this session are offered.
+//   header: u32 magic "ADSR", u32 version, u32 capacity, u32 reserved, u64 x2
+//   entry:  u64 path hash (0 = never used), u32 sources, u32 reserved,
+//           u64 journal time, u64 snapshot time, u64 snapshot XXH64, u64 length
+// Open addressing with linear probing; cleared entries keep their key so
+// probe chains stay intact, and are reused by the next new path.
+static constexpr uint32_t kRecoveryMagic = 0x52534441; // "ADSR"
+static constexpr uint32_t kRecoveryVersion = 1;
+static constexpr uint32_t kRecoveryCapacity = 4096;
+static constexpr uint32_t kRecoveryJournal = 1;
+static constexpr uint32_t kRecoverySnapshot = 2;
+
+struct RecoveryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t reserved;
+    uint64_t reserved2[2];
+};
+
+struct RecoveryEntry
+{
+    uint64_t key;
+    uint32_t sources;
+    uint32_t reserved;
+    uint64_t journalTime;   // UTC FILETIME
+    uint64_t snapTime;
+    uint64_t snapHash;
+    uint64_t snapLength;
+};
+
+static_assert(sizeof(RecoveryHeader) == 32, "recovery header layout");
+static_assert(sizeof(RecoveryEntry) == 48, "recovery entry layout");
+static constexpr size_t kRecoveryIndexBytes = sizeof(RecoveryHeader) + kRecoveryCapacity * sizeof(RecoveryEntry);
+
+static MappedFile   g_recoveryView;         // UI thread, read-only
+static uint64_t     g_sessionStart = 0;     // UTC FILETIME of NPPN_READY
+static std::vector<UINT_PTR> g_recoveryPending;
+static UINT_PTR     g_recoveryTimerId = 0;
+
+static RecoveryEntry* RecoveryEntries(BYTE* view)
+{
+    return (RecoveryEntry*)(view + sizeof(RecoveryHeader));
+}
+
+static bool RecoveryHeaderValid(const BYTE* view)
+{
+    const RecoveryHeader* hdr = (const RecoveryHeader*)view;
+    return hdr->magic == kRecoveryMagic && hdr->version == kRecoveryVersion && hdr->capacity == kRecoveryCapacity;
+}
+
+// Entry for key, or with create the first reusable one; nullptr when absent or full
+static RecoveryEntry* FindRecoveryEntry(BYTE* view, const uint64_t key, const bool create)
+{
+    RecoveryEntry* entries = RecoveryEntries(view);
+    RecoveryEntry* reuse = nullptr;
+
+    for (uint32_t n = 0, i = (uint32_t)(key % kRecoveryCapacity); n < kRecoveryCapacity; ++n, i = (i + 1) % kRecoveryCapacity)
+    {
+        RecoveryEntry& e = entries[i];
+        if (e.key == key) return &e;
+        if (!reuse && e.sources == 0) reuse = &e;
+        if (e.key == 0) break;
+    }
+
+    if (!create || !reuse) return nullptr;
+
+    ZeroMemory(reuse, sizeof(RecoveryEntry));
+    reuse->key = key;
+    return reuse;
+}
+
+// Writer thread: reflect a finished job in the index
+static void NoteRecovery(MappedFile& idx, const std::wstring& path, const WriteJob& job)
+{
+    if (!job.recovery || !job.recoveryKey || path.empty()) return;
+
+    if (!idx.view)
+    {
+        if (!idx.Open(path, kRecoveryIndexBytes, true)) return;
+        if (!RecoveryHeaderValid(idx.view))
+        {
+            ZeroMemory(idx.view, kRecoveryIndexBytes);
+            RecoveryHeader* hdr = (RecoveryHeader*)idx.view;
+            hdr->magic = kRecoveryMagic;
+            hdr->version = kRecoveryVersion;
+            hdr->capacity = kRecoveryCapacity;
+        }
+    }
+
+    const bool drop = job.kind == WriteJob::Remove;
+    RecoveryEntry* e = FindRecoveryEntry(idx.view, job.recoveryKey, !drop);
+    if (!e) return;
+
+    if (drop)
+    {
+        e->sources &= ~job.recovery;
+        return;
+    }
+
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+
+    e->sources |= job.recovery;
+    if (job.recovery == kRecoveryJournal)
+    {
+        e->journalTime = FileTimeU64(now);
+    }
+    else
+    {
+        e->snapTime = FileTimeU64(now);
+        e->snapHash = job.hash;
+        e->snapLength = job.size;
+    }
+}
+
+static std::wstring BackupPathFor(const std::wstring& path)
+{
+    const std::wstring dir = PluginDataDir(L"Backup");
+    return dir.empty() ? dir : dir + L"\\" + StoreNameFor(path, L"bak");
+}
+
+// Saved or closed on purpose: a backup of unsaved edits is no longer needed
+static void ForgetBackup(const UINT_PTR id)
+{
+    const std::wstring path = GetBufferPath(id);
+    if (!IsNamedPath(path)) return;
+
+    WriteJob job;
+    job.kind = WriteJob::Remove;
+    job.target = BackupPathFor(path);
+    job.recovery = kRecoverySnapshot;
+    job.recoveryKey = HashPath(path);
+    if (!job.target.empty()) QueueWrite(std::move(job));
+}
+
+// ================================
+// Settings
+// ================================
+// plugins\Config\AutoDaveSave\AutoDaveSave.ini, one "Key=Value" per line.
+// Read in setInfo, before the menu is built; rewritten through the writer
+// whenever a menu setting changes. Missing keys keep the defaults above.
+static std::wstring SettingsPath()
+{
+    const std::wstring dir = PluginDataDir(nullptr);
+    return dir.empty() ? dir : dir + L"\\AutoDaveSave.ini";
+}
+
+static std::string TrimA(const std::string& s)
+{
+    const size_t b = s.find_first_not_of(" \t\r\n");
+    if (b == std::string::npos) return std::string();
+    return s.substr(b, s.find_last_not_of(" \t\r\n") - b + 1);
+}
+
+static void ApplySetting(const std::string& key, const std::string& value)
+{
+    const int n = atoi(value.c_str());
+
+    if (key == "Enabled") g_enabled = (n != 0);
+    else if (key == "Minutes") { if (n >= 1 && n <= 1440) g_minutes = n; }
+    else if (key == "Adaptive") g_adaptive = (n != 0);
+    else if (key == "TypingPause") g_idleMode = (n != 0);
+    else if (key == "TypingPauseSeconds") { if (n >= 1 && n <= 600) g_idleSeconds = n; }
+    else if (key == "SaveOnLeave") g_saveOnLeave = (n != 0);
+    else if (key == "SnapshotOnly") g_snapshotOnly = (n != 0);
+    else if (key == "Journal") g_journal = (n != 0);
+    else if (key == "History") g_history = (n != 0);
+    else if (key == "SessionCheckpoint") g_sessionCheckpoint = (n != 0);
+    else if (key == "WarmupSeconds") { if (n >= 0 && n <= 3600) g_warmupSeconds = n; }
+    else if (key == "JitterSeconds") { if (n >= 0 && n <= 3600) g_jitterSeconds = n; }
+    else if (key == "UiBudgetPercent")
+    {
+        const double pct = atof(value.c_str());
+        if (pct > 0.0 && pct <= 50.0) g_uiBudgetPct = pct;
+    }
+}
+
+static void LoadSettings()
+{
+    std::string text;
+    if (!ReadWholeFile(SettingsPath(), text)) return;
+
+    size_t at = 0;
+    while (at < text.size())
+    {
+        size_t end = text.find('\n', at);
+        if (end == std::string::npos) end = text.size();
+        const std::string line = TrimA(text.substr(at, end - at));
+        at = end + 1;
+
+        if (line.empty() || line[0] == '#' || line[0] == ';' || line[0] == '[') continue;
+
+        const size_t eq = line.find('=');
+        if (eq != std::string::npos) ApplySetting(TrimA(line.substr(0, eq)), TrimA(line.substr(eq + 1)));
+    }
+}
+
+static void SaveSettings()
+{
+    const std::wstring path = SettingsPath();
+    if (path.empty()) return;
+
+    char budget[32] = {};
+    snprintf(budget, sizeof(budget), "%g", g_uiBudgetPct);
+
+    WriteJob job;
+    job.target = path;
+    job.data =
+        "[AutoDaveSave]\r\n"
+        "Enabled=" + std::to_string(g_enabled ? 1 : 0) + "\r\n"
+        "Minutes=" + std::to_string(g_minutes) + "\r\n"
+        "Adaptive=" + std::to_string(g_adaptive ? 1 : 0) + "\r\n"
+        "TypingPause=" + std::to_string(g_idleMode ? 1 : 0) + "\r\n"
+        "TypingPauseSeconds=" + std::to_string(g_idleSeconds) + "\r\n"
+        "SaveOnLeave=" + std::to_string(g_saveOnLeave ? 1 : 0) + "\r\n"
+        "SnapshotOnly=" + std::to_string(g_snapshotOnly ? 1 : 0) + "\r\n"
+        "Journal=" + std::to_string(g_journal ? 1 : 0) + "\r\n"
+        "History=" + std::to_string(g_history ? 1 : 0) + "\r\n"
+        "SessionCheckpoint=" + std::to_string(g_sessionCheckpoint ? 1 : 0) + "\r\n"
+        "WarmupSeconds=" + std::to_string(g_warmupSeconds) + "\r\n"
+        "JitterSeconds=" + std::to_string(g_jitterSeconds) + "\r\n"
+        "UiBudgetPercent=" + budget + "\r\n";
+    QueueWrite(std::move(job));
+}
+
+// ================================
+// Autosave Rules
+// ================================
+// plugins\Config\AutoDaveSave\Rules.txt, one rule per line:
+//   <pattern> [> <size>] : <action>[, <action>...]
+// A pattern without a backslash matches the file name, otherwise the full
+// path; * and ? are wildcards and case is ignored. For each setting the
+// first matching rule in the file decides.
+//
+// The file is compiled once when loaded (and again when it is saved from
+// Notepad++): "*.ext" patterns go into a hash map, everything else into a
+// trie keyed by the pattern's literal prefix, one for names and one for
+// paths. A lookup walks the folded name and path once, collecting only the
+// rules whose prefix matched, and confirms them against the precompiled
+// glob. Buffers are evaluated on open, save and rename and the result is
+// kept in BufferEntry::rule, so ticks never touch the matcher.
+static constexpr const wchar_t* kRulesTemplate =
+    L"# AutoDaveSave rules, one per line:  <pattern> [> <size>] : <action>, <action>\r\n"
+    L"#\r\n"
+    L"# Patterns without a backslash match the file name, others the full path.\r\n"
+    L"# * and ? are wildcards; case is ignored. <size> is the file size on disk\r\n"
+    L"# (KB, MB or GB). For each setting the first matching rule wins.\r\n"
+    L"#\r\n"
+    L"# Actions: never | every <n> s|min|h | snapshot only | save files | adaptive\r\n"
+    L"#\r\n"
+    L"# *.log > 50 MB : every 10 min, snapshot only\r\n"
+    L"# \\\\fileserver\\* : adaptive\r\n"
+    L"# *.tmp : never\r\n";
+
+// Pattern split at '*'; '?' matches any one character inside a part
+struct RuleGlob
+{
+    std::vector<std::wstring> parts;
+    bool anchoredStart = true;   // No leading '*'
+    bool anchoredEnd = true;     // No trailing '*'
+};
+
+struct Rule
+{
+    RuleGlob   glob;
+    bool       nameOnly = false;
+    uint64_t   minSize = 0;      // "> size": only files larger than this
+    RuleAction action;
+};
+
+struct RuleTrieNode
+{
+    std::vector<std::pair<wchar_t, uint32_t>> next;   // Sorted by character
+    std::vector<uint32_t> rules;                      // Literal prefix ends here
+};
+
+struct RuleSet
+{
+    std::vector<Rule> rules;     // File order is priority order
+    std::unordered_map<std::wstring, std::vector<uint32_t>> byExtension;
+    std::vector<RuleTrieNode> nameTrie = std::vector<RuleTrieNode>(1);
+    std::vector<RuleTrieNode> pathTrie = std::vector<RuleTrieNode>(1);
+    std::vector<size_t> badLines;
+};
+
+static RuleSet g_rules;
+
+static std::wstring RulesPath()
+{
+    const std::wstring dir = PluginDataDir(nullptr);
+    return dir.empty() ? dir : dir + L"\\Rules.txt";
+}
+
+static std::wstring FoldPath(const std::wstring& path)
+{
+    std::wstring out(path);
+    for (wchar_t& c : out) c = (c == L'/') ? L'\\' : (wchar_t)towlower(c);
+    return out;
+}
+
+static std::wstring TrimW(const std::wstring& s)
+{
+    const size_t b = s.find_first_not_of(L" \t");
+    if (b == std::wstring::npos) return std::wstring();
+    return s.substr(b, s.find_last_not_of(L" \t") - b + 1);
+}
+
+static RuleGlob CompileGlob(const std::wstring& pattern)
+{
+    RuleGlob g;
+    g.anchoredStart = pattern.empty() || pattern.front() != L'*';
+    g.anchoredEnd = pattern.empty() || pattern.back() != L'*';
+
+    size_t at = 0;
+    while (at <= pattern.size())
+    {
+        size_t star = pattern.find(L'*', at);
+        if (star == std::wstring::npos) star = pattern.size();
+        if (star > at) g.parts.push_back(pattern.substr(at, star - at));
+        at = star + 1;
+    }
+    return g;
+}
+
+static bool PartAt(const std::wstring& part, const wchar_t* s)
+{
+    for (size_t i = 0; i < part.size(); ++i)
+        if (part[i] != L'?' && part[i] != s[i]) return false;
+    return true;
+}
+
+static bool GlobMatch(const RuleGlob& g, const std::wstring& s)
+{
+    size_t first = 0, last = g.parts.size();
+    size_t pos = 0, end = s.size();
+
+    if (last == 1 && g.anchoredStart && g.anchoredEnd)
+        return s.size() == g.parts[0].size() && PartAt(g.parts[0], s.c_str());
+
+    if (g.anchoredStart && first < last)
+    {
+        const std::wstring& p = g.parts[first++];
+        if (end < p.size() || !PartAt(p, s.c_str())) return false;
+        pos = p.size();
+    }
+    if (g.anchoredEnd && first < last)
+    {
+        const std::wstring& p = g.parts[--last];
+        if (end - pos < p.size() || !PartAt(p, s.c_str() + end - p.size())) return false;
+        end -= p.size();
+    }
+
+    // Middle parts in order, each at its earliest fit
+    for (size_t i = first; i < last; ++i)
+    {
+        const std::wstring& p = g.parts[i];
+        while (pos + p.size() <= end && !PartAt(p, s.c_str() + pos)) ++pos;
+        if (pos + p.size() > end) return false;
+        pos += p.size();
+    }
+    return true;
+}
+
+static void TrieInsert(std::vector<RuleTrieNode>& trie, const std::wstring& prefix, const uint32_t rule)
+{
+    uint32_t node = 0;
+    for (const wchar_t c : prefix)
+    {
+        auto& next = trie[node].next;
+        auto it = std::lower_bound(next.begin(), next.end(), c,
+            [](const std::pair<wchar_t, uint32_t>& n, const wchar_t v) { return n.first < v; });
+
+        if (it == next.end() || it->first != c)
+        {
+            const uint32_t child = (uint32_t)trie.size();
+            it = next.insert(it, { c, child });
+            trie.emplace_back();
+        }
+        node = it->second;
+    }
+    trie[node].rules.push_back(rule);
+}
+
+// Rules whose literal prefix is a prefix of s
+static void TrieCollect(const std::vector<RuleTrieNode>& trie, const std::wstring& s, std::vector<uint32_t>& out)
+{
+    uint32_t node = 0;
+    for (size_t i = 0;; ++i)
+    {
+        out.insert(out.end(), trie[node].rules.begin(), trie[node].rules.end());
+        if (i == s.size()) break;
+
+        const auto& next = trie[node].next;
+        auto it = std::lower_bound(next.begin(), next.end(), s[i],
+            [](const std::pair<wchar_t, uint32_t>& n, const wchar_t v) { return n.first < v; });
+        if (it == next.end() || it->first != s[i]) break;
+        node = it->second;
+    }
+}
+
+// "50 MB", "512k", "1048576"
+static bool ParseRuleSize(const std::wstring& text, uint64_t& bytes)
+{
+    wchar_t* end = nullptr;
+    const unsigned long long n = wcstoull(text.c_str(), &end, 10);
+    if (end == text.c_str()) return false;
+
+    const std::wstring unit = TrimW(end);
+    uint64_t scale = 1;
+    if (unit == L"kb" || unit == L"k") scale = 1ull << 10;
+    else if (unit == L"mb" || unit == L"m") scale = 1ull << 20;
+    else if (unit == L"gb" || unit == L"g") scale = 1ull << 30;
+    else if (!unit.empty() && unit != L"b") return false;
+
+    bytes = (uint64_t)n * scale;
+    return true;
+}
+
+// "every 10 min", "every 30 s", "every 2 h"
+static bool ParseRuleInterval(const std::wstring& text, DWORD& ms)
+{
+    wchar_t* end = nullptr;
+    const unsigned long n = wcstoul(text.c_str(), &end, 10);
+    if (end == text.c_str() || n == 0) return false;
+
+    const std::wstring unit = TrimW(end);
+    uint64_t scale = 0;
+    if (unit == L"s" || unit == L"sec" || unit == L"secs" || unit == L"second" || unit == L"seconds") scale = 1000;
+    else if (unit == L"m" || unit == L"min" || unit == L"mins" || unit == L"minute" || unit == L"minutes") scale = 60u * 1000u;
+    else if (unit == L"h" || unit == L"hour" || unit == L"hours") scale = 60u * 60u * 1000u;
+    else return false;
+
+    const uint64_t total = (uint64_t)n * scale;
+    if (total > 24ull * 60u * 60u * 1000u) return false;
+    ms = (DWORD)total;
+    return true;
+}
+
+static bool ParseRuleLine(const std::wstring& raw, Rule& rule)
+{
+    const std::wstring line = FoldPath(raw);
+
+    // Actions never contain ':', so the last one separates them (drive letters stay in the pattern)
+    const size_t colon = line.rfind(L':');
+    if (colon == std::wstring::npos) return false;
+
+    std::wstring pattern = line.substr(0, colon);
+    const size_t gt = pattern.find(L'>');
+    if (gt != std::wstring::npos)
+    {
+        if (!ParseRuleSize(TrimW(pattern.substr(gt + 1)), rule.minSize)) return false;
+        pattern.resize(gt);
+    }
+    pattern = TrimW(pattern);
+    if (pattern.empty()) return false;
+
+    rule.glob = CompileGlob(pattern);
+    rule.nameOnly = (pattern.find(L'\\') == std::wstring::npos);
+
+    RuleAction& a = rule.action;
+    const std::wstring actions = line.substr(colon + 1);
+    size_t at = 0;
+    while (at <= actions.size())
+    {
+        size_t comma = actions.find(L',', at);
+        if (comma == std::wstring::npos) comma = actions.size();
+        const std::wstring act = TrimW(actions.substr(at, comma - at));
+        at = comma + 1;
+
+        if (act == L"never") { a.set |= kRuleNever; a.never = true; }
+        else if (act == L"adaptive") { a.set |= kRuleAdaptive; a.adaptive = true; }
+        else if (act == L"snapshot only" || act == L"snapshots only") { a.set |= kRuleSnapshot; a.snapshot = true; }
+        else if (act == L"save files") { a.set |= kRuleSnapshot; a.snapshot = false; }
+        else if (act.compare(0, 6, L"every ") == 0 && ParseRuleInterval(TrimW(act.substr(6)), a.intervalMs)) a.set |= kRuleInterval;
+        else return false;
+    }
+    return a.set != 0;
+}
+
+static void IndexRule(RuleSet& set, const uint32_t index)
+{
+    const Rule& r = set.rules[index];
+    const RuleGlob& g = r.glob;
+
+    // "*.ext": the bulk of real rules, one hash lookup per buffer
+    if (r.nameOnly && !g.anchoredStart && g.anchoredEnd && g.parts.size() == 1)
+    {
+        const std::wstring& ext = g.parts[0];
+        if (ext.size() > 1 && ext[0] == L'.' && ext.find_first_of(L".?", 1) == std::wstring::npos)
+        {
+            set.byExtension[ext].push_back(index);
+            return;
+        }
+    }
+
+    const std::wstring prefix = g.anchoredStart ? g.parts[0].substr(0, g.parts[0].find(L'?')) : std::wstring();
+    TrieInsert(r.nameOnly ? set.nameTrie : set.pathTrie, prefix, index);
+}
+
+static void EvaluateRules(BufferEntry& e)
+{
+    e.rule = RuleAction();
+    if (g_rules.rules.empty()) return;
+
+    const std::wstring path = GetBufferPath(e.id);
+    if (!IsNamedPath(path)) return;
+
+    const std::wstring folded = FoldPath(path);
+    const size_t slash = folded.find_last_of(L'\\');
+    const std::wstring name = (slash == std::wstring::npos) ? folded : folded.substr(slash + 1);
+
+    std::vector<uint32_t> hits;
+    const size_t dot = name.find_last_of(L'.');
+    if (dot != std::wstring::npos)
+    {
+        auto it = g_rules.byExtension.find(name.substr(dot));
+        if (it != g_rules.byExtension.end()) hits = it->second;
+    }
+    TrieCollect(g_rules.nameTrie, name, hits);
+    TrieCollect(g_rules.pathTrie, folded, hits);
+    if (hits.empty()) return;
+
+    std::sort(hits.begin(), hits.end());
+
+    bool stamped = false;
+    uint64_t size = 0, writeTime = 0;
+
+    RuleAction& out = e.rule;
+    for (const uint32_t index : hits)
+    {
+        const Rule& r = g_rules.rules[index];
+        const uint8_t fresh = r.action.set & ~out.set;
+        if (!fresh) continue;
+        if (!GlobMatch(r.glob, r.nameOnly ? name : folded)) continue;
+
+        if (r.minSize)
+        {
+            if (!stamped) stamped = GetDiskStamp(path, size, writeTime);
+            if (!stamped || size <= r.minSize) continue;
+        }
+
+        out.set |= fresh;
+        if (fresh & kRuleNever) out.never = true;
+        if (fresh & kRuleInterval) out.intervalMs = r.action.intervalMs;
+        if (fresh & kRuleSnapshot) out.snapshot = r.action.snapshot;
+        if (fresh & kRuleAdaptive) out.adaptive = r.action.adaptive;
+        if (out.never) break;
+    }
+}
+
+static void ResyncSchedule();
+
+// Path or file size may have changed; reschedule when the outcome did
+static void RefreshRules(const UINT_PTR id)
+{
+    BufferEntry* e = FindBuffer(id);
+    if (!e) return;
+
+    const RuleAction before = e->rule;
+    EvaluateRules(*e);
+
+    const RuleAction& now = e->rule;
+    if (before.set == now.set && before.never == now.never && before.snapshot == now.snapshot &&
+        before.adaptive == now.adaptive && before.intervalMs == now.intervalMs)
+        return;
+
+    if (e->due)
+    {
+        e->due = 0;
+        ++e->schedGen;
+    }
+    UpdateSchedule(*e);
+}
+
+static bool IsRulesFile(const UINT_PTR id)
+{
+    const std::wstring rules = RulesPath();
+    return !rules.empty() && _wcsicmp(GetBufferPath(id).c_str(), rules.c_str()) == 0;
+}
+
+// setInfo, and whenever Rules.txt is saved from Notepad++
+static void LoadRules()
+{
+    RuleSet set;
+
+    std::string bytes;
+    if (ReadWholeFile(RulesPath(), bytes))
+    {
+        if (bytes.size() >= 3 && memcmp(bytes.data(), "\xEF\xBB\xBF", 3) == 0) bytes.erase(0, 3);
+
+        std::wstring text;
+        const int chars = MultiByteToWideChar(CP_UTF8, 0, bytes.data(), (int)bytes.size(), nullptr, 0);
+        if (chars > 0)
+        {
+            text.resize((size_t)chars);
+            MultiByteToWideChar(CP_UTF8, 0, bytes.data(), (int)bytes.size(), &text[0], chars);
+        }
+
+        size_t at = 0, lineNo = 0;
+        while (at < text.size())
+        {
+            size_t end = text.find(L'\n', at);
+            if (end == std::wstring::npos) end = text.size();
+            std::wstring line = text.substr(at, end - at);
+            at = end + 1;
+            ++lineNo;
+
+            if (!line.empty() && line.back() == L'\r') line.pop_back();
+            line = TrimW(line);
+            if (line.empty() || line[0] == L'#' || line[0] == L';') continue;
+
+            Rule rule;
+            if (!ParseRuleLine(line, rule))
+            {
+                set.badLines.push_back(lineNo);
+                continue;
+            }
+
+            set.rules.push_back(std::move(rule));
+            IndexRule(set, (uint32_t)(set.rules.size() - 1));
+        }
+    }
+
+    g_rules = std::move(set);
+
+    for (BufferEntry& e : g_buffers) EvaluateRules(e);
+    ResyncSchedule();
+    NotifyDebugChanged();
+}
+
+// Menu: open Rules.txt in Notepad++, starting from a commented template
+static void EditRules()
+{
+    const std::wstring path = RulesPath();
+    if (path.empty()) return;
+
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h != INVALID_HANDLE_VALUE)
+    {
+        const int len = WideCharToMultiByte(CP_UTF8, 0, kRulesTemplate, -1, nullptr, 0, nullptr, nullptr);
+        std::string utf8((size_t)(len > 0 ? len - 1 : 0), '\0');
+        if (len > 1) WideCharToMultiByte(CP_UTF8, 0, kRulesTemplate, -1, &utf8[0], len, nullptr, nullptr);
+        WriteAll(h, utf8);
+        CloseHandle(h);
+    }
+
+    SendMessageW(g_hNppWnd, NPPM_DOOPEN, 0, (LPARAM)path.c_str());
+}
+
+// ================================
+// Instance Coordination
+// ================================
+// Notepad++ started with -multiInst runs one plugin copy per process. They
+// share a small named mapping in the session namespace:
+//   header: u32 magic "ADSX", u32 version, u32 capacity, u32 reserved,
+//           u64 next free tick turn (GetTickCount64 is system-wide), u64 reserved
+//   instances: u32 pid x kCoordInstances
+//   claims: u64 path hash, u64 XXH64, u64 length, u64 disk size, u64 disk
+//           write time, u32 pid, u32 reserved
+// Ticks take turns kCoordStaggerMs apart instead of hitting the disk
+// together, and a save is skipped when another instance already wrote the
+// same text to the same file and the file has not changed since.
+static constexpr const wchar_t* kCoordMapName = L"Local\\AutoDaveSave.Coordinator.1";
+static constexpr const wchar_t* kCoordLockName = L"Local\\AutoDaveSave.Coordinator.1.Lock";
+static constexpr uint32_t kCoordMagic = 0x58534441; // "ADSX"
+static constexpr uint32_t kCoordVersion = 1;
+static constexpr uint32_t kCoordCapacity = 1024;
+static constexpr uint32_t kCoordProbe = 16;         // Claims probed before the oldest is replaced
+static constexpr uint32_t kCoordInstances = 16;
+static constexpr DWORD    kCoordStaggerMs = 1500;
+static constexpr DWORD    kCoordMaxDeferMs = 30000;
+static constexpr DWORD    kCoordLockWaitMs = 50;    // UI thread: give up rather than stall
+
+struct CoordHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t capacity;
+    uint32_t reserved;
+    uint64_t nextTurn;
+    uint64_t reserved2;
+};
+
+struct CoordClaim
+{
+    uint64_t key;
+    uint64_t hash;
+    uint64_t length;
+    uint64_t diskSize;
+    uint64_t diskTime;
+    uint32_t pid;
+    uint32_t reserved;
+};
+
+static_assert(sizeof(CoordHeader) == 32, "coordinator header layout");
+static_assert(sizeof(CoordClaim) == 48, "coordinator claim layout");
+static constexpr size_t kCoordBytes = sizeof(CoordHeader) + kCoordInstances * sizeof(uint32_t) + kCoordCapacity * sizeof(CoordClaim);
+
+static HANDLE g_hCoordMap = nullptr;
+static HANDLE g_hCoordLock = nullptr;
+static BYTE*  g_coordView = nullptr;
+static DWORD  g_coordDeduped = 0;     // Saves skipped, another instance wrote the same text
+static DWORD  g_coordDeferred = 0;    // Ticks moved to a later turn
+static DWORD  g_lastTickDeduped = 0;
+static DWORD  g_coordLive = 0;        // Instances seen at the last turn, for the debug window
+
+// Scoped hold of the cross-process lock; held is false on timeout
+struct CoordLock
+{
+    bool held = false;
+
+    CoordLock()
+    {
+        if (!g_hCoordLock || !g_coordView) return;
+        const DWORD r = WaitForSingleObject(g_hCoordLock, kCoordLockWaitMs);
+        held = (r == WAIT_OBJECT_0 || r == WAIT_ABANDONED);
+    }
+
+    ~CoordLock()
+    {
+        if (held) ReleaseMutex(g_hCoordLock);
+    }
+};
+
+static uint32_t* CoordPids()
+{
+    return (uint32_t*)(g_coordView + sizeof(CoordHeader));
+}
+
+static CoordClaim* CoordClaims()
+{
+    return (CoordClaim*)(g_coordView + sizeof(CoordHeader) + kCoordInstances * sizeof(uint32_t));
+}
+
+static bool IsProcessAlive(const DWORD pid)
+{
+    const HANDLE h = OpenProcess(SYNCHRONIZE, FALSE, pid);
+    if (!h) return false;
+    const bool alive = WaitForSingleObject(h, 0) == WAIT_TIMEOUT;
+    CloseHandle(h);
+    return alive;
+}
+
+// Under the coordinator lock: instances alive right now, this one included;
+// slots of exited ones are freed
+static DWORD ReapCoordInstances()
+{
+    DWORD live = 0;
+    uint32_t* pids = CoordPids();
+    for (uint32_t i = 0; i < kCoordInstances; ++i)
+    {
+        if (!pids[i]) continue;
+        if (pids[i] == GetCurrentProcessId() || IsProcessAlive(pids[i])) ++live;
+        else pids[i] = 0;
+    }
+    return live;
+}
+
+// NPPN_READY. Without the mapping every instance simply runs on its own.
+static void StartCoordinator()
+{
+    if (g_coordView) return;
+
+    g_hCoordLock = CreateMutexW(nullptr, FALSE, kCoordLockName);
+    g_hCoordMap = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)kCoordBytes, kCoordMapName);
+    if (g_hCoordLock && g_hCoordMap)
+        g_coordView = (BYTE*)MapViewOfFile(g_hCoordMap, FILE_MAP_ALL_ACCESS, 0, 0, kCoordBytes);
+
+    CoordLock lock;
+    if (!lock.held) return;
+
+    CoordHeader* hdr = (CoordHeader*)g_coordView;
+    if (hdr->magic != kCoordMagic || hdr->version != kCoordVersion || hdr->capacity != kCoordCapacity)
+    {
+        ZeroMemory(g_coordView, kCoordBytes);
+        hdr->magic = kCoordMagic;
+        hdr->version = kCoordVersion;
+        hdr->capacity = kCoordCapacity;
+    }
+
+    uint32_t* pids = CoordPids();
+    for (uint32_t i = 0; i < kCoordInstances; ++i)
+    {
+        if (pids[i] && pids[i] != GetCurrentProcessId() && IsProcessAlive(pids[i])) continue;
+        pids[i] = GetCurrentProcessId();
+        break;
+    }
+    g_coordLive = ReapCoordInstances();
+}
+
+static void StopCoordinator()
+{
+    if (g_coordView)
+    {
+        CoordLock lock;
+        if (lock.held)
+        {
+            uint32_t* pids = CoordPids();
+            for (uint32_t i = 0; i < kCoordInstances; ++i)
+                if (pids[i] == GetCurrentProcessId()) pids[i] = 0;
+        }
+        UnmapViewOfFile(g_coordView);
+    }
+    if (g_hCoordMap) CloseHandle(g_hCoordMap);
+    if (g_hCoordLock) CloseHandle(g_hCoordLock);
+
+    g_coordView = nullptr;
+    g_hCoordMap = nullptr;
+    g_hCoordLock = nullptr;
+}
+
+// Take the next tick turn; returns the tick count at which it starts.
+// A turn left far ahead by an instance that died is not honoured.
+static ULONGLONG ReserveTickTurn(const ULONGLONG now)
+{
+    CoordLock lock;
+    if (!lock.held) return now;
+
+    // Once per tick, so the debug window can show the count without the lock
+    g_coordLive = ReapCoordInstances();
+
+    CoordHeader* hdr = (CoordHeader*)g_coordView;
+    ULONGLONG turn = hdr->nextTurn;
+    if (turn < now || turn > now + kCoordMaxDeferMs) turn = now;
+
+    hdr->nextTurn = turn + kCoordStaggerMs;
+    return turn;
+}
+
+// Claim for key, or with create the slot to overwrite (empty or oldest in the probe run)
+static CoordClaim* FindCoordClaim(const uint64_t key, const bool create)
+{
+    CoordClaim* claims = CoordClaims();
+    CoordClaim* reuse = nullptr;
+
+    for (uint32_t n = 0, i = (uint32_t)(key % kCoordCapacity); n < kCoordProbe; ++n, i = (i + 1) % kCoordCapacity)
+    {
+        CoordClaim& c = claims[i];
+        if (c.key == key) return &c;
+        if (c.key == 0)
+        {
+            if (!reuse) reuse = &c;
+            break;
+        }
+        if (!reuse || c.diskTime < reuse->diskTime) reuse = &c;
+    }
+
+    if (!create) return nullptr;
+
+    ZeroMemory(reuse, sizeof(CoordClaim));
+    reuse->key = key;
+    return reuse;
+}
+
+// NPPN_FILESAVED, after RecordSavedHash: tell other instances what the file now holds
+static void PublishSave(const UINT_PTR id)
+{
+    const BufferEntry* e = FindBuffer(id);
+    if (!e || !e->savedHashKnown || !g_coordView) return;
+
+    const uint64_t key = HashPath(GetBufferPath(id));
+
+    CoordLock lock;
+    if (!lock.held) return;
+
+    CoordClaim* c = FindCoordClaim(key, true);
+    c->hash = e->savedHash;
+    c->length = e->savedLength;
+    c->diskSize = e->savedDiskSize;
+    c->diskTime = e->savedDiskTime;
+    c->pid = GetCurrentProcessId();
+}
+
+// True when another instance saved exactly this text to path and the file
+// still carries the stamp it left. The buffer then adopts that save.
+static bool SavedByOtherInstance(const UINT_PTR id, const std::wstring& path)
+{
+    if (!g_coordView) return false;
+
+    CoordClaim claim{};
+    {
+        CoordLock lock;
+        if (!lock.held) return false;
+
+        const CoordClaim* c = FindCoordClaim(HashPath(path), false);
+        if (!c) return false;
+        claim = *c;
+    }
+    if (claim.pid == GetCurrentProcessId()) return false;
+
+    uint64_t diskSize = 0, diskTime = 0;
+    if (!GetDiskStamp(path, diskSize, diskTime) || diskSize != claim.diskSize || diskTime != claim.diskTime) return false;
+
+    uint64_t hash = 0, length = 0;
+    if (!HashBufferText(id, hash, length) || hash != claim.hash || length != claim.length) return false;
+
+    BufferEntry& e = TouchBuffer(id);
+    e.savedHashKnown = true;
+    e.matchesSaved = true;
+    e.savedHash = hash;
+    e.savedLength = length;
+    e.savedDiskSize = diskSize;
+    e.savedDiskTime = diskTime;
+    return true;
+}
+
+// ================================
+// Save Metrics
+// ================================
+// Rolling latency window; percentiles are computed on demand for the debug view
+static constexpr size_t kLatencySamples = 256;
+static constexpr size_t kCostEntriesMax = 128;
+static constexpr DWORD  kAdaptiveMaxMs = 60u * 60u * 1000u;
+
+struct LatencyRing
+{
+    double samples[kLatencySamples] = {};
+    size_t count = 0;
+    size_t next = 0;
+
+    void Add(const double ms)
+    {
+        samples[next] = ms;
+        next = (next + 1) % kLatencySamples;
+        if (count < kLatencySamples) ++count;
+    }
+
+    double Percentile(const double p) const
+    {
+        if (!count) return 0.0;
+
+        std::vector<double> v(samples, samples + count);
+        const size_t k = (size_t)(p * (double)(count - 1) + 0.5);
+        std::nth_element(v.begin(), v.begin() + (ptrdiff_t)k, v.end());
+        return v[k];
+    }
+
+    double Max() const
+    {
+        return count ? *std::max_element(samples, samples + count) : 0.0;
+    }
+};
+
+// Accumulated save cost per file path or per volume
+struct SaveCost
+{
+    std::wstring key;
+    DWORD    saves = 0;
+    double   lastMs = 0.0;
+    double   maxMs = 0.0;
+    double   totalMs = 0.0;
+    uint64_t bytes = 0;
+};
+
+static LatencyRing g_fileLatency;
+static LatencyRing g_tickLatency;
+static std::vector<SaveCost> g_fileCosts;
+static std::vector<SaveCost> g_volumeCosts;
+static uint64_t g_lastTickBytes = 0;
+static uint64_t g_totalBytes = 0;
+
+// Save in flight; NPPN_FILESAVED for this buffer stamps its completion
+static UINT_PTR g_inflightId = 0;
+static LONGLONG g_inflightDone = 0;
+
+static LONGLONG QpcNow()
+{
+    LARGE_INTEGER t{};
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+static double QpcToMs(const LONGLONG ticks)
+{
+    static LONGLONG freq = 0;
+    if (!freq)
+    {
+        LARGE_INTEGER f{};
+        QueryPerformanceFrequency(&f);
+        freq = f.QuadPart ? f.QuadPart : 1;
+    }
+    return (double)ticks * 1000.0 / (double)freq;
+}
+
+static void AddCost(std::vector<SaveCost>& table, const std::wstring& key, const double ms, const uint64_t bytes)
+{
+    auto it = std::find_if(table.begin(), table.end(), [&](const SaveCost& c) { return c.key == key; });
+    if (it == table.end())
+    {
+        // Bounded: forget the cheapest entry to make room
+        if (table.size() >= kCostEntriesMax)
+        {
+            table.erase(std::min_element(table.begin(), table.end(),
+                [](const SaveCost& a, const SaveCost& b) { return a.totalMs < b.totalMs; }));
+        }
+
+        SaveCost c;
+        c.key = key;
+        table.push_back(c);
+        it = table.end() - 1;
+    }
+
+    ++it->saves;
+    it->lastMs = ms;
+    it->maxMs = (std::max)(it->maxMs, ms);
+    it->totalMs += ms;
+    it->bytes += bytes;
+}
+
+// Smoothed so one slow save stretches the interval without pinning it there
+static void NoteSaveCost(const UINT_PTR id, const double ms)
+{
+    BufferEntry* e = FindBuffer(id);
+    if (!e) return;
+
+    e->costMs = e->costKnown ? (e->costMs * 0.7 + ms * 0.3) : ms;
+    e->costKnown = true;
+}
+
+static void RecordFileSave(const std::wstring& path, const double ms, const uint64_t bytes)
+{
+    g_fileLatency.Add(ms);
+    AddCost(g_fileCosts, path, ms, bytes);
+    AddCost(g_volumeCosts, VolumeOf(path), ms, bytes);
+
+    g_lastTickBytes += bytes;
+    g_totalBytes += bytes;
+}
+
+static std::wstring FormatMs(const double ms)
+{
+    std::wstringstream ss;
+    ss << std::fixed << std::setprecision(ms < 10.0 ? 2 : 1) << ms << L" ms";
+    return ss.str();
+}
+
+static std::wstring FormatBytes(const uint64_t bytes)
+{
+    std::wstringstream ss;
+    if (bytes >= (1ull << 30)) ss << std::fixed << std::setprecision(2) << (double)bytes / (double)(1ull << 30) << L" GB";
+    else if (bytes >= (1ull << 20)) ss << std::fixed << std::setprecision(1) << (double)bytes / (double)(1ull << 20) << L" MB";
+    else if (bytes >= 1024) ss << std::fixed << std::setprecision(1) << (double)bytes / 1024.0 << L" KB";
+    else ss << bytes << L" B";
+    return ss.str();
+}
+
+static void AppendLatencyLine(std::wstringstream& ss, const wchar_t* label, const LatencyRing& ring)
+{
+    ss << label << L" (" << ring.count << L"): ";
+    if (!ring.count)
+    {
+        ss << L"n/a\r\n";
+        return;
+    }
+
+    ss << L"p50 " << FormatMs(ring.Percentile(0.50))
+        << L", p95 " << FormatMs(ring.Percentile(0.95))
+        << L", p99 " << FormatMs(ring.Percentile(0.99))
+        << L", max " << FormatMs(ring.Max()) << L"\r\n";
+}
+
+// Most expensive entries by accumulated time
+static void AppendCostTable(std::wstringstream& ss, const wchar_t* label, const std::vector<SaveCost>& table, const size_t top)
+{
+    if (table.empty()) return;
+
+    std::vector<const SaveCost*> order;
+    order.reserve(table.size());
+    for (const SaveCost& c : table) order.push_back(&c);
+
+    const size_t n = (std::min)(top, order.size());
+    std::partial_sort(order.begin(), order.begin() + (ptrdiff_t)n, order.end(),
+        [](const SaveCost* a, const SaveCost* b) { return a->totalMs > b->totalMs; });
+
+    ss << label << L":\r\n";
+    for (size_t i = 0; i < n; ++i)
+    {
+        const SaveCost& c = *order[i];
+        ss << L"  " << FormatMs(c.totalMs / (double)c.saves) << L" avg, " << FormatMs(c.maxMs) << L" max, "
+            << c.saves << L" saves, " << FormatBytes(c.bytes) << L"  " << c.key << L"\r\n";
+    }
+}
+
+// ================================
+// Volume Throttle
+// ================================
+// Each target volume has two token buckets, bytes and operations, refilled
+// at a per-kind rate and holding at most one second of it. A save or
+// snapshot may start while both buckets are positive and is charged its real
+// size afterwards, so a large file can overdraw and the volume then rests
+// until the debt is repaid. Buffers that do not fit wait for the refill.
+struct VolumeBudget
+{
+    double bytesPerSec;
+    double opsPerSec;
+};
+
+static constexpr VolumeBudget kBudgetLocal   = { 32.0 * 1024 * 1024, 32.0 };
+static constexpr VolumeBudget kBudgetRemovable = { 8.0 * 1024 * 1024, 8.0 };
+static constexpr VolumeBudget kBudgetNetwork = {  4.0 * 1024 * 1024, 4.0 };
+static constexpr size_t kThrottleVolumesMax = 32;
+
+struct VolumeBucket
+{
+    std::wstring key;
+    VolumeBudget budget{};
+    double       bytes = 0;     // Tokens left; negative while in debt
+    double       ops = 0;
+    ULONGLONG    refilled = 0;
+};
+
+static std::vector<VolumeBucket> g_volumeBuckets;
+static DWORD g_lastTickThrottled = 0;
+static DWORD g_throttledTotal = 0;
+
+// Mapped drives and UNC shares are remote; everything else uses its drive type
+static VolumeBudget BudgetFor(const std::wstring& volume)
+{
+    if (volume.size() >= 2 && (volume[0] == L'\\' || volume[0] == L'/')) return kBudgetNetwork;
+
+    switch (GetDriveTypeW((volume + L"\\").c_str()))
+    {
+    case DRIVE_REMOTE:    return kBudgetNetwork;
+    case DRIVE_REMOVABLE: return kBudgetRemovable;
+    default:              return kBudgetLocal;
+    }
+}
+
+static VolumeBucket& BucketFor(const std::wstring& path)
+{
+    const std::wstring volume = VolumeOf(path);
+    const ULONGLONG now = GetTickCount64();
+
+    auto it = std::find_if(g_volumeBuckets.begin(), g_volumeBuckets.end(),
+        [&](const VolumeBucket& b) { return _wcsicmp(b.key.c_str(), volume.c_str()) == 0; });
+    if (it == g_volumeBuckets.end())
+    {
+        // Bounded: the longest-idle volume is full again anyway
+        if (g_volumeBuckets.size() >= kThrottleVolumesMax)
+        {
+            g_volumeBuckets.erase(std::min_element(g_volumeBuckets.begin(), g_volumeBuckets.end(),
+                [](const VolumeBucket& a, const VolumeBucket& b) { return a.refilled < b.refilled; }));
+        }
+
+        VolumeBucket b;
+        b.key = volume;
+        b.budget = BudgetFor(volume);
+        b.bytes = b.budget.bytesPerSec;
+        b.ops = b.budget.opsPerSec;
+        b.refilled = now;
+        g_volumeBuckets.push_back(b);
+        return g_volumeBuckets.back();
+    }
+
+    const double sec = (double)(now - it->refilled) / 1000.0;
+    it->bytes = (std::min)(it->budget.bytesPerSec, it->bytes + sec * it->budget.bytesPerSec);
+    it->ops = (std::min)(it->budget.opsPerSec, it->ops + sec * it->budget.opsPerSec);
+    it->refilled = now;
+    return *it;
+}
+
+// 0 when a write to path may start now, else how long until both buckets refill
+static DWORD ThrottleWaitMs(const std::wstring& path)
+{
+    const VolumeBucket& b = BucketFor(path);
+    if (b.bytes > 0 && b.ops >= 1.0) return 0;
+
+    const double bytesSec = (b.bytes > 0) ? 0 : (1.0 - b.bytes) / b.budget.bytesPerSec;
+    const double opsSec = (b.ops >= 1.0) ? 0 : (1.0 - b.ops) / b.budget.opsPerSec;
+    return (DWORD)((std::max)(bytesSec, opsSec) * 1000.0) + 1;
+}
+
+static void ChargeThrottle(const std::wstring& path, const uint64_t bytes)
+{
+    VolumeBucket& b = BucketFor(path);
+    b.bytes -= (double)bytes;
+    b.ops -= 1.0;
+}
+
+// Out of budget this tick: give the buffer its own deadline at the refill
+static void DeferBuffer(const UINT_PTR id, const DWORD waitMs)
+{
+    BufferEntry* e = FindBuffer(id);
+    if (!e) return;
+
+    e->due = GetTickCount64() + waitMs;
+    PushDeadline(*e);
+
+    ++g_lastTickThrottled;
+    ++g_throttledTotal;
+}
+
+// ================================
+// Save Engine
+// ================================
+// Save each dirty, already-named buffer by path. Clean and untitled tabs are
+// never touched, so no Save As prompt can appear.
+// NPPN_FILESAVED re-enters beNotified while saving, so callers pass a copy.
+static void SaveBuffers(const std::vector<UINT_PTR>& ids)
+{
+    const LONGLONG tickStart = QpcNow();
+
+    for (const UINT_PTR id : ids)
+    {
+        const BufferEntry* e = FindBuffer(id);
+        if (!e) continue;
+        if (!e->dirty)
+        {
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::FileSave, GetBufferPath(id), 0, TelemetryEvent::Clean);
+            continue;
+        }
+
+        const LONGLONG uiStart = QpcNow();
+        const std::wstring path = GetBufferPath(id);
+        if (!IsNamedPath(path))
+        {
+            ++g_lastTickUntitled;
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::FileSave, path, 0, TelemetryEvent::Untitled);
+            continue;
+        }
+
+        // Type-then-undo, whitespace toggles, reformat round trips
+        if (ContentMatchesSaved(id, path))
+        {
+            ++g_lastTickHashSkipped;
+            ++g_hashSkippedTotal;
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::FileSave, path, 0, TelemetryEvent::Unchanged);
+            MarkVisibleSavepoint(id);
+            NoteSaveCost(id, QpcToMs(QpcNow() - uiStart));
+            continue;
+        }
+
+        // Same file open in another instance, which already wrote this text
+        if (SavedByOtherInstance(id, path))
+        {
+            ++g_lastTickDeduped;
+            ++g_coordDeduped;
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::FileSave, path, 0, TelemetryEvent::OtherInstance);
+            MarkVisibleSavepoint(id);
+            NoteSaveCost(id, QpcToMs(QpcNow() - uiStart));
+            continue;
+        }
+
+        if (const DWORD waitMs = ThrottleWaitMs(path))
+        {
+            DeferBuffer(id, waitMs);
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::FileSave, path, 0, TelemetryEvent::Throttled);
+            continue;
+        }
+
+        g_inflightId = id;
+        g_inflightDone = 0;
+        PushTelemetry(TelemetryEvent::SaveStarted, TelemetryEvent::FileSave, path);
+
+        const LONGLONG start = QpcNow();
+        const BOOL saved = (BOOL)SendMessageW(g_hNppWnd, NPPM_SAVEFILE, 0, (LPARAM)path.c_str());
+        const LONGLONG done = g_inflightDone ? g_inflightDone : QpcNow();
+
+        g_inflightId = 0;
+
+        if (saved)
+        {
+            ++g_lastTickSaved;
+            ++g_savedTotal;
+
+            uint64_t size = 0, writeTime = 0;
+            GetDiskStamp(path, size, writeTime);
+            RecordFileSave(path, QpcToMs(done - start), size);
+            ChargeThrottle(path, size);
+            PushTelemetry(TelemetryEvent::SaveFinished, TelemetryEvent::FileSave, path, size, 0, QpcToMs(done - start));
+        }
+        else
+        {
+            // NPPM_SAVEFILE leaves no thread error behind, so GetLastError would be stale
+            PushTelemetry(TelemetryEvent::SaveFailed, TelemetryEvent::FileSave, path, 0, kSaveRejectedError);
+            ChargeThrottle(path, 0);
+        }
+
+        NoteSaveCost(id, QpcToMs(QpcNow() - uiStart));
+    }
+
+    if (g_lastTickSaved)
+        g_tickLatency.Add(QpcToMs(QpcNow() - tickStart));
+}
+
+// Snapshot-only mode: copy each edited buffer (untitled included) on the UI
+// thread and hand the bytes to the background writer. Files are not saved.
+static void SnapshotBuffers(const std::vector<UINT_PTR>& ids)
+{
+    const std::wstring dir = PluginDataDir(L"Backup");
+    if (dir.empty()) return;
+
+    for (const UINT_PTR id : ids)
+    {
+        const BufferEntry* pending = FindBuffer(id);
+        if (!pending) continue;
+        if (!pending->stale)
+        {
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::Snapshot, GetBufferPath(id), 0, TelemetryEvent::Clean);
+            continue;
+        }
+
+        // Previous snapshot still waiting on a slow volume: do not read the
+        // text again; the buffer stays stale and is rescheduled
+        const std::wstring target = dir + L"\\" + StoreNameFor(GetBufferPath(id), L"bak");
+        if (IsWritePending(target))
+        {
+            ++g_lastTickBackpressure;
+            ++g_backpressureTotal;
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::Snapshot, target, 0, TelemetryEvent::Backpressure);
+            continue;
+        }
+
+        if (const DWORD waitMs = ThrottleWaitMs(target))
+        {
+            DeferBuffer(id, waitMs);
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::Snapshot, target, 0, TelemetryEvent::Throttled);
+            continue;
+        }
+
+        const LONGLONG uiStart = QpcNow();
+
+        WriteJob job;
+        if (!ReadBufferText(id, job.data)) continue;
+
+        // Same text as the last snapshot: nothing new to write
+        const uint64_t hash = Xxh64(job.data.data(), job.data.size());
+        BufferEntry& e = TouchBuffer(id);
+        SetBufferStale(e, false);
+
+        if (e.snapHashKnown && e.snapHash == hash)
+        {
+            ++g_lastTickHashSkipped;
+            ++g_hashSkippedTotal;
+            PushTelemetry(TelemetryEvent::SaveSkipped, TelemetryEvent::Snapshot, target, 0, TelemetryEvent::Unchanged);
+            NoteSaveCost(id, QpcToMs(QpcNow() - uiStart));
+            continue;
+        }
+        e.snapHashKnown = true;
+        e.snapHash = hash;
+
+        const std::wstring path = GetBufferPath(id);
+        if (g_history)
+            QueueVersion(e, path, PooledCopy(job.data), hash);
+
+        job.target = target;
+        if (IsNamedPath(path))
+        {
+            job.recovery = kRecoverySnapshot;
+            job.recoveryKey = HashPath(path);
+            job.hash = hash;
+            job.size = job.data.size();
+        }
+        ChargeThrottle(target, job.data.size());
+        PushTelemetry(TelemetryEvent::SaveFinished, TelemetryEvent::Snapshot, target, job.data.size(), 0, QpcToMs(QpcNow() - uiStart));
+        QueueWrite(std::move(job));
+        ++g_lastTickQueued;
+        ++g_queuedTotal;
+        NoteSaveCost(id, QpcToMs(QpcNow() - uiStart));
+    }
+
+}
+
+// ================================
+// Change Journal
+// ================================
+// File layout (little endian):
+//   u32 magic "ADSJ", u32 version, u32 base kind, u32 BOM bytes,
+//   u64 disk size, u64 disk write time, u32 path chars, u16[] path,
+//   u64 base length, base bytes (captured bases only),
+//   then records: u8 op, u64 position, u64 length, inserted bytes.
+// A disk base replays on top of the saved file; a captured base carries the
+// document text itself (untitled, UTF-16 or restored-dirty buffers).
+static constexpr uint32_t kJournalMagic = 0x4A534441; // "ADSJ"
+static constexpr uint32_t kJournalVersion = 1;
+static constexpr uint32_t kJournalBaseDisk = 1;
+static constexpr uint32_t kJournalBaseCaptured = 2;
+static constexpr uint8_t  kJournalInsert = 1;
+static constexpr uint8_t  kJournalDelete = 2;
+
+// Notepad++ keeps 8-bit encodings byte-identical to the file, minus the BOM
+static bool DiskBaseBomBytes(const UINT_PTR id, uint32_t& bom)
+{
+    switch (SendMessageW(g_hNppWnd, NPPM_GETBUFFERENCODING, (WPARAM)id, 0))
+    {
+    case 0: // ANSI
+    case 4: // UTF-8 without BOM
+    case 5: // 7-bit
+        bom = 0;
+        return true;
+    case 1: // UTF-8 with BOM
+        bom = 3;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static std::wstring JournalPathFor(const std::wstring& path)
+{
+    const std::wstring dir = PluginDataDir(L"Journal");
+    return dir.empty() ? dir : dir + L"\\" + StoreNameFor(path, L"jrn");
+}
+
+// Start a new journal generation. Uses the saved file as the base when the
+// document is known to match it (preLength is the length before this delta),
+// otherwise embeds the current text. Returns true when the current delta is
+// already contained in the base.
+static bool JournalBegin(BufferEntry& e, const std::wstring& path, const intptr_t preLength, const std::string* text)
+{
+    uint32_t bom = 0;
+    uint64_t diskSize = 0, diskTime = 0;
+
+    const bool diskBase = e.cleanBase && IsNamedPath(path) && DiskBaseBomBytes(e.id, bom)
+        && GetDiskStamp(path, diskSize, diskTime) && diskSize == (uint64_t)preLength + bom;
+
+    PooledText captured(0);
+    if (!diskBase && !text)
+    {
+        if (!ReadBufferText(e.id, captured.text)) return false;
+        text = &captured.text;
+    }
+
+    std::string& out = e.journal;
+    out.clear();
+    PutU32(out, kJournalMagic);
+    PutU32(out, kJournalVersion);
+    PutU32(out, diskBase ? kJournalBaseDisk : kJournalBaseCaptured);
+    PutU32(out, bom);
+    PutU64(out, diskSize);
+    PutU64(out, diskTime);
+    PutU32(out, (uint32_t)path.size());
+    for (const wchar_t c : path)
+    {
+        out.push_back((char)(c & 0xFF));
+        out.push_back((char)((c >> 8) & 0xFF));
+    }
+
+    if (diskBase)
+    {
+        PutU64(out, 0);
+    }
+    else
+    {
+        PutU64(out, (uint64_t)text->size());
+        out += *text;
+    }
+
+    e.cleanBase = false;
+    e.journalOpen = true;
+    e.journalFresh = true;
+    e.journalDrop = false;
+    e.journalBytes = 0;
+    return !diskBase;
+}
+
+static void StopJournalTimer()
+{
+    if (!g_journalTimerId) return;
+    KillTimer(nullptr, g_journalTimerId);
+    g_journalTimerId = 0;
+}
+
+static void JournalFlush();
+
+void CALLBACK JournalTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    StopJournalTimer();
+    JournalFlush();
+}
+
+// Record one insert/delete from a view. Deltas stay in memory until the
+// flush timer hands them to the writer as a single append.
+static void JournalRecord(const HWND hSci, const SCNotification& scn)
+{
+    const int v = (hSci == g_hSciSecond) ? SUB_VIEW : MAIN_VIEW;
+
+    // A cloned document notifies from both views; keep one copy
+    if (v == SUB_VIEW && g_viewBuffer[SUB_VIEW] && g_viewBuffer[SUB_VIEW] == g_viewBuffer[MAIN_VIEW]) return;
+
+    const UINT_PTR id = g_viewBuffer[v];
+    if (!id) return;
+
+    const bool insert = (scn.modificationType & SC_MOD_INSERTTEXT) != 0;
+    BufferEntry& e = TouchBuffer(id);
+
+    bool included = false;
+    if (!e.journalOpen)
+    {
+        const intptr_t length = (intptr_t)SendMessageW(hSci, SCI_GETLENGTH, 0, 0);
+        const intptr_t preLength = insert ? length - scn.length : length + scn.length;
+
+        included = JournalBegin(e, GetBufferPath(id), preLength, nullptr);
+        if (!e.journalOpen) return;
+    }
+
+    if (!included)
+    {
+        std::string& out = e.journal;
+        PutU8(out, insert ? kJournalInsert : kJournalDelete);
+        PutU64(out, (uint64_t)scn.position);
+        PutU64(out, (uint64_t)scn.length);
+        if (insert && scn.text && scn.length > 0) out.append(scn.text, (size_t)scn.length);
+
+        e.journalBytes += 17u + (insert ? (uint64_t)scn.length : 0u);
+    }
+
+    if (!g_journalTimerId)
+        g_journalTimerId = SetTimer(nullptr, 0, (UINT)((g_journalSeconds <= 0 ? 1 : g_journalSeconds) * 1000), JournalTimerProc);
+}
+
+// Hand pending deltas, fresh generations and deletions to the writer
+static void JournalFlush()
+{
+    for (BufferEntry& e : g_buffers)
+    {
+        if (e.journal.empty() && !e.journalDrop) continue;
+
+        const std::wstring path = GetBufferPath(e.id);
+
+        WriteJob job;
+        job.target = JournalPathFor(path);
+        if (job.target.empty()) continue;
+
+        if (IsNamedPath(path))
+        {
+            job.recovery = kRecoveryJournal;
+            job.recoveryKey = HashPath(path);
+        }
+
+        if (e.journalDrop)
+        {
+            job.kind = WriteJob::Remove;
+            e.journalDrop = false;
+        }
+        else
+        {
+            job.kind = e.journalFresh ? WriteJob::Replace : WriteJob::Append;
+            g_journalAppended += e.journal.size();
+            job.data.swap(e.journal);
+            e.journalFresh = false;
+        }
+
+        QueueWrite(std::move(job));
+    }
+}
+
+// Interval compaction for due buffers that were not saved to disk
+// (untitled, failed or snapshot-only): restart with the current text as base.
+static void JournalCompact(const std::vector<UINT_PTR>& ids)
+{
+    for (const UINT_PTR id : ids)
+    {
+        BufferEntry* e = FindBuffer(id);
+        if (!e || !e->journalOpen || e->journalBytes == 0) continue;
+
+        if (JournalBegin(*e, GetBufferPath(id), 0, nullptr))
+            ++g_journalCompactions;
+    }
+}
+
+// Buffer is closing: its journal is no longer needed
+static void JournalDiscard(const UINT_PTR id)
+{
+    BufferEntry* e = FindBuffer(id);
+    if (!e) return;
+
+    e->journalOpen = false;
+    e->journalFresh = false;
+    e->journalDrop = false;
+    e->journal.clear();
+
+    const std::wstring path = GetBufferPath(id);
+
+    WriteJob job;
+    job.kind = WriteJob::Remove;
+    job.target = JournalPathFor(path);
+    job.recovery = kRecoveryJournal;
+    job.recoveryKey = IsNamedPath(path) ? HashPath(path) : 0;
+    if (!job.target.empty()) QueueWrite(std::move(job));
+}
+
+// Rebuild the document a journal describes
+static bool ReplayJournal(const std::string& jrn, std::string& out)
+{
+    size_t at = 0;
+    uint32_t magic = 0, version = 0, kind = 0, bom = 0, pathChars = 0;
+    uint64_t diskSize = 0, diskTime = 0, baseLen = 0;
+
+    if (!GetU32(jrn, at, magic) || magic != kJournalMagic) return false;
+    if (!GetU32(jrn, at, version) || version != kJournalVersion) return false;
+    if (!GetU32(jrn, at, kind) || !GetU32(jrn, at, bom)) return false;
+    if (!GetU64(jrn, at, diskSize) || !GetU64(jrn, at, diskTime)) return false;
+    if (!GetU32(jrn, at, pathChars) || jrn.size() - at < (size_t)pathChars * 2u) return false;
+
+    std::wstring path(pathChars, L'\0');
+    for (uint32_t i = 0; i < pathChars; ++i, at += 2)
+        path[i] = (wchar_t)((uint8_t)jrn[at] | ((uint8_t)jrn[at + 1] << 8));
+
+    if (!GetU64(jrn, at, baseLen) || jrn.size() - at < baseLen) return false;
+
+    if (kind == kJournalBaseDisk)
+    {
+        uint64_t size = 0, writeTime = 0;
+        if (!GetDiskStamp(path, size, writeTime) || size != diskSize || writeTime != diskTime) return false;
+        if (!ReadWholeFile(path, out) || out.size() < bom) return false;
+        out.erase(0, bom);
+    }
+    else if (kind == kJournalBaseCaptured)
+    {
+        out.assign(jrn, at, (size_t)baseLen);
+    }
+    else
+    {
+        return false;
+    }
+    at += (size_t)baseLen;
+
+    // A torn trailing record (crash mid-append) ends the replay
+    while (jrn.size() - at >= 17)
+    {
+        const uint8_t op = (uint8_t)jrn[at++];
+        uint64_t pos = 0, len = 0;
+        GetU64(jrn, at, pos);
+        GetU64(jrn, at, len);
+
+        if (pos > out.size()) return false;
+
+        if (op == kJournalInsert)
+        {
+            if (jrn.size() - at < len) break;
+            out.insert((size_t)pos, jrn, at, (size_t)len);
+            at += (size_t)len;
+        }
+        else if (op == kJournalDelete)
+        {
+            if (len > out.size() - pos) return false;
+            out.erase((size_t)pos, (size_t)len);
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ================================
+// Metrics Export
+// ================================
+// Counters for monitoring agents, in the named mapping
+// "Local\AutoDaveSave.Metrics.<pid>". The layout, MetricsBlock, is public
+// and lives in AutoDaveSaveMsgs.h; ADSM_GETSTATS hands out the same fields.
+static HANDLE        g_hMetricsMap = nullptr;
+static MetricsBlock* g_metrics = nullptr;
+
+static void StartMetricsExport()
+{
+    if (g_metrics) return;
+
+    const std::wstring name = L"Local\\AutoDaveSave.Metrics." + std::to_wstring(GetCurrentProcessId());
+    g_hMetricsMap = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0, (DWORD)sizeof(MetricsBlock), name.c_str());
+    if (!g_hMetricsMap) return;
+
+    g_metrics = (MetricsBlock*)MapViewOfFile(g_hMetricsMap, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(MetricsBlock));
+    if (!g_metrics)
+    {
+        CloseHandle(g_hMetricsMap);
+        g_hMetricsMap = nullptr;
+        return;
+    }
+
+    ZeroMemory(g_metrics, sizeof(MetricsBlock));
+    g_metrics->magic = kMetricsMagic;
+    g_metrics->version = kMetricsVersion;
+    g_metrics->size = (uint32_t)sizeof(MetricsBlock);
+    g_metrics->pid = GetCurrentProcessId();
+}
+
+static void StopMetricsExport()
+{
+    if (g_metrics) UnmapViewOfFile(g_metrics);
+    if (g_hMetricsMap) CloseHandle(g_hMetricsMap);
+    g_metrics = nullptr;
+    g_hMetricsMap = nullptr;
+}
+
+// UI thread
+static void FillMetrics(MetricsBlock& m)
+{
+    m.magic = kMetricsMagic;
+    m.version = kMetricsVersion;
+    m.size = (uint32_t)sizeof(MetricsBlock);
+    m.pid = GetCurrentProcessId();
+
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+    m.updated = FileTimeU64(now);
+
+    m.enabled = g_enabled ? 1u : 0u;
+    m.mode = g_snapshotOnly ? 1u : 0u;
+    m.intervalMs = g_intervalMs;
+    m.dirtyBuffers = (uint32_t)g_dirtyCount;
+    m.trackedBuffers = (uint32_t)g_buffers.size();
+    m.scheduled = (uint32_t)g_deadlines.size();
+
+    TelemetryEvent ev;
+    if (LatestTelemetry(ev, [](const TelemetryEvent& t) { return t.kind == TelemetryEvent::SaveFinished && t.source != TelemetryEvent::Writer; }))
+        m.lastSave = ev.time;
+    if (LatestTelemetry(ev, [](const TelemetryEvent& t) { return t.kind == TelemetryEvent::SaveFailed && t.source == TelemetryEvent::FileSave; }))
+    {
+        m.lastError = ev.time;
+        m.lastErrorCode = ev.detail;
+    }
+    if (LatestTelemetry(ev, [](const TelemetryEvent& t) { return t.kind == TelemetryEvent::SaveFailed && t.source == TelemetryEvent::Writer; }))
+        m.lastWriterErrorCode = ev.detail;
+
+    m.ticks = g_ticksRun;
+    m.filesSaved = g_savedTotal;
+    m.snapshotsQueued = g_queuedTotal;
+    m.unchangedSkipped = g_hashSkippedTotal;
+    m.otherInstanceSkipped = g_coordDeduped;
+    m.throttled = g_throttledTotal;
+    m.backpressure = g_backpressureTotal;
+    m.busyTicksSkipped = g_busyTicksSkipped;
+
+    m.bytesSaved = g_totalBytes;
+    m.journalBytes = g_journalAppended;
+    m.versionsStored = g_versionsStored.load();
+    m.versionRawBytes = g_versionRawBytes.load();
+    m.versionStoredBytes = g_versionStoredBytes.load();
+    m.writerDone = g_writesDone.load();
+    m.writerFailed = g_writesFailed.load();
+    m.writerPending = WriterQueueDepth();
+
+    m.fileP50 = g_fileLatency.Percentile(0.50);
+    m.fileP95 = g_fileLatency.Percentile(0.95);
+    m.fileP99 = g_fileLatency.Percentile(0.99);
+    m.fileMax = g_fileLatency.Max();
+    m.tickP50 = g_tickLatency.Percentile(0.50);
+    m.tickP95 = g_tickLatency.Percentile(0.95);
+    m.tickP99 = g_tickLatency.Percentile(0.99);
+    m.tickMax = g_tickLatency.Max();
+}
+
+// UI thread, after each tick and at startup
+static void PublishMetrics()
+{
+    if (!g_metrics) return;
+
+    MetricsBlock m{};
+    FillMetrics(m);
+
+    // Seqlock write: odd, body, even
+    volatile uint64_t* seq = &g_metrics->seq;
+    const uint64_t next = *seq + 1;
+    m.seq = next + 1;
+
+    *seq = next;
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy((BYTE*)g_metrics + offsetof(MetricsBlock, updated), (const BYTE*)&m + offsetof(MetricsBlock, updated),
+        sizeof(MetricsBlock) - offsetof(MetricsBlock, updated));
+    std::atomic_thread_fence(std::memory_order_release);
+    *seq = next + 1;
+}
+
+// ================================
+// Deadline Scheduler
+// ================================
+// Every pending buffer (dirty, or edited since its snapshot in snapshot mode)
+// owns one deadline in a min-heap. A single timer is armed for the earliest
+// one, so nothing wakes up while no buffer has unsaved work.
+static bool DeadlineLater(const Deadline& a, const Deadline& b)
+{
+    return a.due > b.due;
+}
+
+// A rule can put one buffer in snapshot mode, or back to saving files
+static bool BufferSnapshotOnly(const BufferEntry& e)
+{
+    return (e.rule.set & kRuleSnapshot) ? e.rule.snapshot : g_snapshotOnly;
+}
+
+static bool IsBufferPending(const BufferEntry& e)
+{
+    if (e.rule.never) return false;
+    return BufferSnapshotOnly(e) ? e.stale : e.dirty;
+}
+
+// Adaptive: give each scheduled buffer an equal slice of the UI budget and
+// stretch its interval until its measured save cost fits. The selected
+// minutes (or the rule's interval) stay the floor; a tab is never saved
+// more often than that.
+static DWORD AdaptiveIntervalMs(const BufferEntry& e, const DWORD floorMs)
+{
+    if (!e.costKnown || g_uiBudgetPct <= 0.0) return floorMs;
+
+    size_t scheduled = 1;
+    for (const BufferEntry& other : g_buffers)
+        if (other.due && other.id != e.id) ++scheduled;
+
+    const double share = g_uiBudgetPct / 100.0 / (double)scheduled;
+    const double wantMs = e.costMs / share;
+
+    if (wantMs <= (double)floorMs) return floorMs;
+    if (wantMs >= (double)kAdaptiveMaxMs) return (std::max)(floorMs, kAdaptiveMaxMs);
+    return (DWORD)wantMs;
+}
+
+static DWORD BufferIntervalMs(const BufferEntry& e)
+{
+    if (e.intervalMs) return e.intervalMs;
+
+    const DWORD base = (e.rule.set & kRuleInterval) ? e.rule.intervalMs : g_intervalMs;
+    const bool adaptive = (e.rule.set & kRuleAdaptive) ? e.rule.adaptive : g_adaptive;
+    return adaptive ? AdaptiveIntervalMs(e, base) : base;
+}
+
+static bool IsDeadlineLive(const Deadline& d)
+{
+    const BufferEntry* e = FindBuffer(d.id);
+    return e && e->due == d.due && e->schedGen == d.gen;
+}
+
+static void StopAutosaveTimer()
+{
+    if (!g_schedTimerId) return;
+    KillTimer(nullptr, g_schedTimerId);
+    g_schedTimerId = 0;
+    g_armedDue = 0;
+}
+
+void CALLBACK AutosaveTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+static bool IsAutosavePaused()
+{
+    return g_pausedLocked || g_pausedSuspended || g_pausedSaver || g_pausedApi;
+}
+
+// Slack the OS may add so our wakeup lands with others; also the window in
+// which neighbouring deadlines are taken together when the timer fires.
+static DWORD SchedulerToleranceMs()
+{
+    const DWORD tol = g_intervalMs / 16u;
+    if (tol < 100u) return 100u;
+    if (tol > 5000u) return 5000u;
+    return tol;
+}
+
+typedef UINT_PTR(WINAPI* SetCoalescableTimerFn)(HWND, UINT_PTR, UINT, TIMERPROC, ULONG);
+
+// SetCoalescableTimer is Windows 8+; resolve it so Windows 7 still loads the DLL
+static UINT_PTR SetAutosaveTimer(const UINT delayMs)
+{
+    static SetCoalescableTimerFn setCoalescable = nullptr;
+    static bool resolved = false;
+
+    if (!resolved)
+    {
+        resolved = true;
+        if (HMODULE user32 = GetModuleHandleW(L"user32.dll"))
+            setCoalescable = (SetCoalescableTimerFn)GetProcAddress(user32, "SetCoalescableTimer");
+    }
+
+    if (setCoalescable)
+        return setCoalescable(nullptr, 0, delayMs, AutosaveTimerProc, SchedulerToleranceMs());
+
+    return SetTimer(nullptr, 0, delayMs, AutosaveTimerProc);
+}
+
+// Arm the single timer for the earliest live deadline
+static void ArmScheduler()
+{
+    while (!g_deadlines.empty() && !IsDeadlineLive(g_deadlines.front()))
+    {
+        std::pop_heap(g_deadlines.begin(), g_deadlines.end(), DeadlineLater);
+        g_deadlines.pop_back();
+    }
+
+    if (!g_enabled || !g_hNppWnd || !g_ready || g_deadlines.empty() || IsAutosavePaused())
+    {
+        StopAutosaveTimer();
+        return;
+    }
+
+    const ULONGLONG due = (std::max)((std::max)(g_deadlines.front().due, g_warmupUntil), g_turnAt);
+    if (g_schedTimerId && due == g_armedDue) return;
+
+    const ULONGLONG now = GetTickCount64();
+    const ULONGLONG delay = (due > now) ? (due - now) : 0;
+
+    StopAutosaveTimer();
+    g_schedTimerId = SetAutosaveTimer((UINT)((delay < USER_TIMER_MINIMUM) ? USER_TIMER_MINIMUM : delay));
+    g_armedDue = due;
+    NotifyDebugChanged();
+}
+
+static void PushDeadline(BufferEntry& e)
+{
+    ++e.schedGen;
+
+    Deadline d;
+    d.due = e.due;
+    d.id = e.id;
+    d.gen = e.schedGen;
+
+    g_deadlines.push_back(d);
+    std::push_heap(g_deadlines.begin(), g_deadlines.end(), DeadlineLater);
+}
+
+// Recompute every deadline from when its buffer became pending
+static void RebuildSchedule()
+{
+    g_deadlines.clear();
+
+    for (BufferEntry& e : g_buffers)
+    {
+        if (!e.due) continue;
+
+        e.due = e.pendingSince + BufferIntervalMs(e);
+        PushDeadline(e);
+    }
+
+    ArmScheduler();
+}
+
+// Called whenever a buffer's dirty or stale flag changes
+static void UpdateSchedule(BufferEntry& e)
+{
+    const bool pending = IsBufferPending(e);
+
+    if (pending && !e.due)
+    {
+        e.pendingSince = GetTickCount64();
+        e.due = e.pendingSince + BufferIntervalMs(e);
+        PushDeadline(e);
+
+        if (!g_schedTimerId || e.due < g_armedDue)
+            ArmScheduler();
+    }
+    else if (!pending && e.due)
+    {
+        // Lazy removal; the heap entry dies when it reaches the top
+        e.due = 0;
+        ++e.schedGen;
+
+        if (g_deadlines.size() > 64 && g_deadlines.size() > 2 * g_buffers.size())
+            RebuildSchedule();
+    }
+}
+
+// Mode changes alter which buffers count as pending
+static void ResyncSchedule()
+{
+    for (BufferEntry& e : g_buffers)
+    {
+        if (!IsBufferPending(e) && e.due)
+        {
+            e.due = 0;
+            ++e.schedGen;
+        }
+        else
+        {
+            UpdateSchedule(e);
+        }
+    }
+
+    RebuildSchedule();
+}
+
+static void RunAutosave(const std::vector<UINT_PTR>& ids)
+{
+    g_saveBusy = true;
+
+    const LONGLONG tickStart = QpcNow();
+    TraceLoggingWrite(g_etwProvider, "Tick", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingUInt32((uint32_t)ids.size(), "Buffers"), TraceLoggingUInt32(g_snapshotOnly ? 1u : 0u, "SnapshotOnly"));
+
+    if (!ids.empty())
+    {
+        g_lastTickSaved = 0;
+        g_lastTickQueued = 0;
+        g_lastTickUntitled = 0;
+        g_lastTickHashSkipped = 0;
+        g_lastTickDeduped = 0;
+        g_lastTickThrottled = 0;
+        g_lastTickBackpressure = 0;
+        g_lastTickBytes = 0;
+
+        // Rules can mix snapshot-only and saved buffers in one tick
+        std::vector<UINT_PTR> saveIds, snapIds;
+        for (const UINT_PTR id : ids)
+        {
+            const BufferEntry* e = FindBuffer(id);
+            if (e && BufferSnapshotOnly(*e)) snapIds.push_back(id);
+            else saveIds.push_back(id);
+        }
+
+        if (!snapIds.empty()) SnapshotBuffers(snapIds);
+        if (!saveIds.empty())
+        {
+            SaveBuffers(saveIds);
+
+            // Snapshots queued their versions while they had the text
+            if (g_history) CaptureHistory(saveIds);
+        }
+    }
+
+    // Saved buffers dropped their journals above; everything else compacts
+    if (g_journal)
+    {
+        JournalCompact(ids);
+        JournalFlush();
+    }
+
+    TraceLoggingWrite(g_etwProvider, "Tick", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingUInt32((uint32_t)ids.size(), "Buffers"),
+        TraceLoggingUInt32(g_lastTickQueued + g_lastTickSaved, "Written"),
+        TraceLoggingUInt32(g_lastTickHashSkipped, "Unchanged"),
+        TraceLoggingUInt32(g_lastTickThrottled, "Throttled"),
+        TraceLoggingUInt32(g_lastTickBackpressure, "Backpressure"),
+        TraceLoggingUInt64(g_lastTickBytes, "Bytes"),
+        TraceLoggingFloat32((float)QpcToMs(QpcNow() - tickStart), "UiMs"));
+
+    g_saveBusy = false;
+    WakeWriter();
+
+    ++g_ticksRun;
+    ArmPoolTrim();
+    PublishMetrics();
+    NotifyDebugChanged();
+}
+
+// Save everything pending now (typing pause)
+static void RunAutosaveAll()
+{
+    SyncVisibleDirtyState();
+
+    std::vector<UINT_PTR> ids;
+    for (const BufferEntry& e : g_buffers)
+        if (IsBufferPending(e)) ids.push_back(e.id);
+
+    RunAutosave(ids);
+}
+
+void CALLBACK AutosaveTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    StopAutosaveTimer();
+
+    if (!g_enabled) return;
+    if (!g_hNppWnd) return;
+    if (IsAutosavePaused()) return;
+
+    // A save prompt or a stalled share pumped messages mid-save. Leave the
+    // deadlines queued; the outer pass re-arms the timer when it returns.
+    if (g_saveBusy)
+    {
+        ++g_busyTicksSkipped;
+        TraceLoggingWrite(g_etwProvider, "TickSkipped", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(L"save in progress", "Reason"));
+        return;
+    }
+
+    // Another instance has the disk: come back on the turn reserved for us
+    if (!g_turnAt)
+    {
+        const ULONGLONG now = GetTickCount64();
+        const ULONGLONG turn = ReserveTickTurn(now);
+        if (turn > now + USER_TIMER_MINIMUM)
+        {
+            g_turnAt = turn;
+            ++g_coordDeferred;
+            TraceLoggingWrite(g_etwProvider, "TickSkipped", TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+                TraceLoggingWideString(L"other instance's turn", "Reason"), TraceLoggingUInt64(turn - now, "DeferMs"));
+            ArmScheduler();
+            return;
+        }
+    }
+    g_turnAt = 0;
+
+    SyncVisibleDirtyState();
+
+    // Pop every deadline due within the tolerance; their buffers leave the heap
+    const ULONGLONG horizon = GetTickCount64() + SchedulerToleranceMs();
+    std::vector<UINT_PTR> ids;
+
+    while (!g_deadlines.empty() && g_deadlines.front().due <= horizon)
+    {
+        const Deadline d = g_deadlines.front();
+        std::pop_heap(g_deadlines.begin(), g_deadlines.end(), DeadlineLater);
+        g_deadlines.pop_back();
+
+        if (!IsDeadlineLive(d)) continue;
+
+        ids.push_back(d.id);
+        if (BufferEntry* e = FindBuffer(d.id)) e->due = 0;
+    }
+
+    TraceLoggingWrite(g_etwProvider, "TickFired", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(L"deadline", "Trigger"),
+        TraceLoggingUInt32((uint32_t)ids.size(), "Due"), TraceLoggingUInt32((uint32_t)g_deadlines.size(), "Scheduled"));
+
+    RunAutosave(ids);
+
+    // Still pending (untitled, failed, restored): try again one interval later
+    for (const UINT_PTR id : ids)
+        if (BufferEntry* e = FindBuffer(id)) UpdateSchedule(*e);
+
+    ArmScheduler();
+}
+
+static void StartAutosaveTimer()
+{
+    g_intervalMs = ComputeIntervalMs(g_minutes);
+    RebuildSchedule();
+}
+
+// NPPN_READY: the session is loaded. Deadlines gathered while it restored
+// fire no earlier than the warm-up plus a per-process random jitter.
+static void BeginAutosaveAfterWarmup()
+{
+    const DWORD warmupMs = (DWORD)((g_warmupSeconds < 0) ? 0 : g_warmupSeconds) * 1000u;
+    const DWORD jitterMs = (DWORD)((g_jitterSeconds < 0) ? 0 : g_jitterSeconds) * 1000u;
+
+    // splitmix64 over the counter and process id; only needs to differ per machine
+    uint64_t z = (uint64_t)QpcNow() ^ ((uint64_t)GetCurrentProcessId() << 32);
+    z += 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    z ^= z >> 31;
+
+    g_warmupUntil = GetTickCount64() + warmupMs + (jitterMs ? z % (jitterMs + 1u) : 0);
+    g_ready = true;
+
+    ArmScheduler();
+}
+
+// ================================
+// Power Awareness
+// ================================
+// A hidden top-level window receives lock, suspend and battery saver changes.
+// While paused the scheduler timer is gone; on resume the paused span is
+// added to every deadline, so nothing that came due meanwhile fires at once.
+static const wchar_t* POWER_CLASS = L"AutoDaveSavePowerWnd";
+
+// GUID_POWER_SAVING_STATUS (battery saver, Windows 10)
+static const GUID kGuidPowerSavingStatus =
+    { 0xe00958c0, 0xc213, 0x4ace, { 0xac, 0x77, 0xfe, 0xcc, 0xed, 0x2e, 0xee, 0xa5 } };
+
+// GUID_ENERGY_SAVER_STATUS (energy saver, Windows 11)
+static const GUID kGuidEnergySaverStatus =
+    { 0x550e8400, 0xe29b, 0x41d4, { 0xa7, 0x16, 0x44, 0x66, 0x55, 0x44, 0x00, 0x00 } };
+
+static bool SameGuid(const GUID& a, const GUID& b)
+{
+    return memcmp(&a, &b, sizeof(GUID)) == 0;
+}
+
+static void SetPaused(bool& flag, const bool paused)
+{
+    if (flag == paused) return;
+
+    const bool wasPaused = IsAutosavePaused();
+    flag = paused;
+    const bool nowPaused = IsAutosavePaused();
+
+    if (!wasPaused && nowPaused)
+    {
+        g_pauseStart = GetTickCount64();
+        ++g_pauseCount;
+        StopAutosaveTimer();
+    }
+    else if (wasPaused && !nowPaused)
+    {
+        // Shift by the paused span; tabs edited during the pause start fresh
+        const ULONGLONG now = GetTickCount64();
+        const ULONGLONG span = now - g_pauseStart;
+
+        for (BufferEntry& e : g_buffers)
+        {
+            if (!e.due) continue;
+            e.pendingSince = (e.pendingSince < g_pauseStart) ? e.pendingSince + span : now;
+        }
+
+        RebuildSchedule();
+    }
+
+    NotifyDebugChanged();
+}
+
+static void SaveOnLeave(const std::vector<UINT_PTR>& left, const wchar_t* trigger);
+static void SaveVisibleOnLeave();
+
+static LRESULT CALLBACK PowerWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+    // Top-level windows of the thread hear when Notepad++ loses the foreground.
+    // Save after the switch completes instead of holding up the other app.
+    case WM_ACTIVATEAPP:
+        if (!wParam && g_saveOnLeave) PostMessageW(hwnd, kLeaveSaveMsg, 0, 0);
+        return 0;
+
+    case kLeaveSaveMsg:
+        if (wParam) SaveOnLeave({ (UINT_PTR)wParam }, L"tab left");
+        else SaveVisibleOnLeave();
+        return 0;
+
+    case WM_WTSSESSION_CHANGE:
+        if (wParam == WTS_SESSION_LOCK) SetPaused(g_pausedLocked, true);
+        else if (wParam == WTS_SESSION_UNLOCK) SetPaused(g_pausedLocked, false);
+        return 0;
+
+    case WM_POWERBROADCAST:
+        switch (wParam)
+        {
+        case PBT_APMSUSPEND:
+            SetPaused(g_pausedSuspended, true);
+            break;
+        case PBT_APMRESUMEAUTOMATIC:
+        case PBT_APMRESUMESUSPEND:
+            SetPaused(g_pausedSuspended, false);
+            break;
+        case PBT_POWERSETTINGCHANGE:
+        {
+            const POWERBROADCAST_SETTING* ps = (const POWERBROADCAST_SETTING*)lParam;
+            if (!ps || ps->DataLength < sizeof(DWORD)) break;
+
+            DWORD value = 0;
+            memcpy(&value, ps->Data, sizeof(value));
+
+            // Both report 0 when off; energy saver uses 1 and 2 for its levels
+            if (SameGuid(ps->PowerSetting, kGuidPowerSavingStatus) ||
+                SameGuid(ps->PowerSetting, kGuidEnergySaverStatus))
+                SetPaused(g_pausedSaver, value != 0);
+            break;
+        }
+        }
+        return TRUE;
+    }
+
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+static void StartPowerWatch()
+{
+    if (g_hPowerWnd) return;
+
+    WNDCLASSEXW wc{};
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = PowerWndProc;
+    wc.hInstance = g_hInst;
+    wc.lpszClassName = POWER_CLASS;
+    RegisterClassExW(&wc);
+
+    // Top-level (not message-only) so suspend and resume broadcasts arrive
+    g_hPowerWnd = CreateWindowExW(WS_EX_TOOLWINDOW, POWER_CLASS, L"", WS_POPUP,
+        0, 0, 0, 0, nullptr, nullptr, g_hInst, nullptr);
+    if (!g_hPowerWnd) return;
+
+    WTSRegisterSessionNotification(g_hPowerWnd, NOTIFY_FOR_THIS_SESSION);
+
+    // Registration delivers the current value, so starting on battery saver pauses
+    g_hSaverNotify = RegisterPowerSettingNotification(g_hPowerWnd, &kGuidPowerSavingStatus, DEVICE_NOTIFY_WINDOW_HANDLE);
+    g_hEnergyNotify = RegisterPowerSettingNotification(g_hPowerWnd, &kGuidEnergySaverStatus, DEVICE_NOTIFY_WINDOW_HANDLE);
+}
+
+static void StopPowerWatch()
+{
+    if (!g_hPowerWnd) return;
+
+    if (g_hSaverNotify) UnregisterPowerSettingNotification(g_hSaverNotify);
+    if (g_hEnergyNotify) UnregisterPowerSettingNotification(g_hEnergyNotify);
+    g_hSaverNotify = nullptr;
+    g_hEnergyNotify = nullptr;
+
+    WTSUnRegisterSessionNotification(g_hPowerWnd);
+    DestroyWindow(g_hPowerWnd);
+    g_hPowerWnd = nullptr;
+}
+
+// ================================
+// Typing-Pause Timer
+// ================================
+static DWORD ComputeIdleMs()
+{
+    const int safeSecs = (g_idleSeconds <= 0) ? 1 : g_idleSeconds;
+    return static_cast<DWORD>(safeSecs) * 1000u;
+}
+
+static void StopIdleTimer()
+{
+    if (!g_idleTimerId) return;
+    KillTimer(nullptr, g_idleTimerId);
+    g_idleTimerId = 0;
+}
+
+void CALLBACK IdleTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+static void ArmIdleTimer(const DWORD delayMs)
+{
+    StopIdleTimer();
+    g_idleTimerId = SetTimer(nullptr, 0, delayMs, IdleTimerProc);
+}
+
+void CALLBACK IdleTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    StopIdleTimer();
+
+    if (!g_enabled || !g_idleMode || !g_ready) return;
+    if (!g_hNppWnd) return;
+
+    // Typing pauses are edit-driven, so battery saver does not hold them
+    if (g_pausedLocked || g_pausedSuspended || g_pausedApi) return;
+
+    // Edits made while the session restores wait for the warm-up to end
+    const ULONGLONG now = GetTickCount64();
+    if (now < g_warmupUntil)
+    {
+        ArmIdleTimer((DWORD)(g_warmupUntil - now));
+        return;
+    }
+
+    if (g_saveBusy)
+    {
+        ++g_busyTicksSkipped;
+        TraceLoggingWrite(g_etwProvider, "TickSkipped", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(L"save in progress", "Reason"));
+        ArmIdleTimer(ComputeIdleMs());
+        return;
+    }
+
+    // Edits keep landing: wait out the remainder instead of re-arming per keystroke
+    const DWORD idleMs = ComputeIdleMs();
+    const ULONGLONG quietMs = GetTickCount64() - g_lastEditTick;
+    if (quietMs < idleMs)
+    {
+        ArmIdleTimer((DWORD)(idleMs - quietMs));
+        return;
+    }
+
+    TraceLoggingWrite(g_etwProvider, "TickFired", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(L"typing pause", "Trigger"),
+        TraceLoggingUInt32((uint32_t)quietMs, "QuietMs"));
+
+    // Saved buffers leave the heap, so each cap restarts from its next edit
+    RunAutosaveAll();
+
+    // Re-arm in case a deadline fired and was deferred while saving
+    ArmScheduler();
+}
+
+// Called for every text change. Only stamps the time unless the timer is idle.
+static void NoteEditActivity()
+{
+    g_lastEditTick = GetTickCount64();
+
+    if (g_enabled && g_idleMode && g_ready && !g_idleTimerId)
+        ArmIdleTimer(ComputeIdleMs());
+}
+
+// ================================
+// Leave Saves
+// ================================
+// Optional: save a pending tab the moment the user moves away from it, when
+// another tab takes its view or Notepad++ loses the foreground. The save
+// then lands while nobody is typing in that document, and its periodic
+// deadline goes away with the dirty flag; only tabs never left wait for
+// the interval.
+static DWORD g_leaveTicks = 0;
+
+static void SaveOnLeave(const std::vector<UINT_PTR>& left, const wchar_t* trigger)
+{
+    if (!g_saveOnLeave || !g_enabled || !g_ready || !g_hNppWnd) return;
+    if (g_saveBusy || IsAutosavePaused() || GetTickCount64() < g_warmupUntil) return;
+
+    std::vector<UINT_PTR> ids;
+    for (const UINT_PTR id : left)
+    {
+        const BufferEntry* e = id ? FindBuffer(id) : nullptr;
+        if (e && IsBufferPending(*e) && std::find(ids.begin(), ids.end(), id) == ids.end()) ids.push_back(id);
+    }
+    if (ids.empty()) return;
+
+    TraceLoggingWrite(g_etwProvider, "TickFired", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(trigger, "Trigger"),
+        TraceLoggingUInt32((uint32_t)ids.size(), "Due"), TraceLoggingUInt32((uint32_t)g_deadlines.size(), "Scheduled"));
+
+    ++g_leaveTicks;
+    RunAutosave(ids);
+
+    // Untitled, throttled or failed: still pending, so the deadline stands
+    ArmScheduler();
+}
+
+static void SaveVisibleOnLeave()
+{
+    SyncVisibleDirtyState();
+    SaveOnLeave({ g_viewBuffer[MAIN_VIEW], g_viewBuffer[SUB_VIEW] }, L"focus lost");
+}
+
+// ================================
+// Session Checkpoint
+// ================================
+// Optional: keep plugins\Config\AutoDaveSave\Session.xml, a Notepad++
+// session file listing the named tabs of both views in order, with their
+// caret, selection and scroll positions and which tab each view shows.
+// At NPPN_READY the copy left by the previous run becomes
+// Session.previous.xml, so a restart after a crash cannot overwrite the
+// layout before "Reopen Tabs From Previous Run" hands it to NPPM_LOADSESSION.
+//
+// Tab events bump a generation and arm a one-shot timer on the autosave
+// interval; an unchanged generation costs nothing. When it fires the file
+// is rebuilt (a few Notepad++ messages per tab) and goes through the writer
+// only if its hash differs from the last copy written, so caret moves that
+// end where they started, or a tab switched away from and back, write nothing.
+static uint32_t g_sessionGen = 1;       // Bumped for every change to the tab layout
+static uint32_t g_sessionBuiltGen = 0;  // Generation the last checkpoint was built from
+static uint64_t g_sessionHash = 0;      // Of the last checkpoint written, 0 = none
+static DWORD    g_sessionWrites = 0;
+static DWORD    g_sessionUnchanged = 0;
+static DWORD    g_sessionTabs = 0;
+
+static void StopSessionTimer()
+{
+    if (!g_sessionTimerId) return;
+    KillTimer(nullptr, g_sessionTimerId);
+    g_sessionTimerId = 0;
+}
+
+static std::wstring SessionPath(const bool previous = false)
+{
+    const std::wstring dir = PluginDataDir(nullptr);
+    return dir.empty() ? dir : dir + (previous ? L"\\Session.previous.xml" : L"\\Session.xml");
+}
+
+// NPPN_READY, before this run writes its first checkpoint. A run that never
+// wrote one leaves the older copy in place.
+static void RotateSessionCheckpoint()
+{
+    const std::wstring path = SessionPath();
+    if (!path.empty() && GetFileAttributesW(path.c_str()) != INVALID_FILE_ATTRIBUTES)
+        MoveFileExW(path.c_str(), SessionPath(true).c_str(), MOVEFILE_REPLACE_EXISTING);
+}
+
+void CALLBACK SessionTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+static void NoteSessionChanged()
+{
+    ++g_sessionGen;
+
+    if (g_sessionCheckpoint && g_ready && !g_sessionTimerId)
+        g_sessionTimerId = SetTimer(nullptr, 0, (UINT)(g_intervalMs ? g_intervalMs : ComputeIntervalMs(g_minutes)), SessionTimerProc);
+}
+
+// Scintilla keeps the selection per view, so positions can only be read
+// while a buffer is shown; hidden tabs keep the last ones recorded.
+// Returns whether they moved.
+static bool CaptureViewPosition(const HWND hSci)
+{
+    if (!hSci) return false;
+
+    const int v = (hSci == g_hSciSecond) ? SUB_VIEW : MAIN_VIEW;
+    BufferEntry* e = g_viewBuffer[v] ? FindBuffer(g_viewBuffer[v]) : nullptr;
+    if (!e) return false;
+
+    // The view may already show the next document before BUFFERACTIVATED
+    if (e->doc && SendMessageW(hSci, SCI_GETDOCPOINTER, 0, 0) != e->doc) return false;
+
+    const intptr_t anchor = (intptr_t)SendMessageW(hSci, SCI_GETANCHOR, 0, 0);
+    const intptr_t caret = (intptr_t)SendMessageW(hSci, SCI_GETCURRENTPOS, 0, 0);
+    const intptr_t firstLine = (intptr_t)SendMessageW(hSci, SCI_GETFIRSTVISIBLELINE, 0, 0);
+    if (anchor == e->anchor && caret == e->caret && firstLine == e->firstLine) return false;
+
+    e->anchor = anchor;
+    e->caret = caret;
+    e->firstLine = firstLine;
+    return true;
+}
+
+static void AppendXmlEscaped(std::string& out, const std::wstring& text)
+{
+    const int len = WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), nullptr, 0, nullptr, nullptr);
+    std::string utf8((size_t)(len > 0 ? len : 0), '\0');
+    if (len > 0) WideCharToMultiByte(CP_UTF8, 0, text.c_str(), (int)text.size(), &utf8[0], len, nullptr, nullptr);
+
+    for (const char c : utf8)
+    {
+        switch (c)
+        {
+        case '&': out += "&amp;"; break;
+        case '<': out += "&lt;"; break;
+        case '>': out += "&gt;"; break;
+        case '"': out += "&quot;"; break;
+        default: out += c; break;
+        }
+    }
+}
+
+static std::string BuildSessionXml(DWORD& tabs)
+{
+    int current = MAIN_VIEW;
+    SendMessageW(g_hNppWnd, NPPM_GETCURRENTSCINTILLA, 0, (LPARAM)&current);
+
+    std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\r\n<NotepadPlus>\r\n";
+    xml += "    <Session activeView=\"" + std::to_string(current == SUB_VIEW ? 1 : 0) + "\">\r\n";
+
+    tabs = 0;
+    for (int v = MAIN_VIEW; v <= SUB_VIEW; ++v)
+    {
+        const char* tag = (v == MAIN_VIEW) ? "mainView" : "subView";
+        const LRESULT count = SendMessageW(g_hNppWnd, NPPM_GETNBOPENFILES, 0, (LPARAM)(v == MAIN_VIEW ? PRIMARY_VIEW : SECOND_VIEW));
+        const LRESULT active = SendMessageW(g_hNppWnd, NPPM_GETCURRENTDOCINDEX, 0, (LPARAM)v);
+
+        // Untitled tabs cannot be reopened by path; the active index skips them too
+        std::string files;
+        int written = 0;
+        int activeIndex = 0;
+        for (LRESULT i = 0; i < count; ++i)
+        {
+            const UINT_PTR id = (UINT_PTR)SendMessageW(g_hNppWnd, NPPM_GETBUFFERIDFROMPOS, (WPARAM)i, (LPARAM)v);
+            const std::wstring path = id ? GetBufferPath(id) : std::wstring();
+            if (!IsNamedPath(path)) continue;
+
+            if (i == active) activeIndex = written;
+
+            const BufferEntry* e = FindBuffer(id);
+            files += "            <File firstVisibleLine=\"" + std::to_string(e ? e->firstLine : 0)
+                + "\" startPos=\"" + std::to_string(e ? e->anchor : 0)
+                + "\" endPos=\"" + std::to_string(e ? e->caret : 0) + "\" filename=\"";
+            AppendXmlEscaped(files, path);
+            files += "\" />\r\n";
+            ++written;
+        }
+        tabs += (DWORD)written;
+
+        xml += std::string("        <") + tag + " activeIndex=\"" + std::to_string(activeIndex) + "\">\r\n";
+        xml += files;
+        xml += std::string("        </") + tag + ">\r\n";
+    }
+
+    xml += "    </Session>\r\n</NotepadPlus>\r\n";
+    return xml;
+}
+
+static void WriteSessionCheckpoint()
+{
+    if (!g_sessionCheckpoint || !g_hNppWnd || g_sessionBuiltGen == g_sessionGen) return;
+
+    SyncVisibleDirtyState();
+    CaptureViewPosition(g_hSciMain);
+    CaptureViewPosition(g_hSciSecond);
+    StopSessionTimer();
+    g_sessionBuiltGen = g_sessionGen;
+
+    DWORD tabs = 0;
+    std::string xml = BuildSessionXml(tabs);
+    const uint64_t hash = Xxh64(xml.data(), xml.size()) | 1;
+    g_sessionTabs = tabs;
+    if (hash == g_sessionHash)
+    {
+        ++g_sessionUnchanged;
+        return;
+    }
+
+    const std::wstring path = SessionPath();
+    if (path.empty()) return;
+
+    WriteJob job;
+    job.target = path;
+    job.data = std::move(xml);
+    QueueWrite(std::move(job));
+
+    g_sessionHash = hash;
+    ++g_sessionWrites;
+    NotifyDebugChanged();
+}
+
+void CALLBACK SessionTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    StopSessionTimer();
+
+    // Notepad++ pumps messages while saving; try again next interval
+    if (g_saveBusy) NoteSessionChanged();
+    else WriteSessionCheckpoint();
+}
+
+// ================================
+// Plugin Messages
+// ================================
+// NPPM_MSGTOPLUGIN commands from other plugins, declared in AutoDaveSaveMsgs.h.
+// They arrive on the UI thread, possibly while a save has Notepad++ pumping
+// messages, so a save request then is refused instead of nested.
+void CALLBACK ApiPauseTimerProc(HWND, UINT, UINT_PTR, DWORD);
+
+static void StopApiPauseTimer()
+{
+    if (!g_apiPauseTimerId) return;
+    KillTimer(nullptr, g_apiPauseTimerId);
+    g_apiPauseTimerId = 0;
+}
+
+static void EndApiPause()
+{
+    StopApiPauseTimer();
+    g_apiPauseUntil = 0;
+    if (!g_pausedApi) return;
+
+    SetPaused(g_pausedApi, false);
+
+    // Typing pauses that ended while held were dropped; catch up on them
+    const size_t pending = g_snapshotOnly ? g_staleCount : g_dirtyCount;
+    if (g_enabled && g_idleMode && g_ready && pending && !g_idleTimerId)
+        ArmIdleTimer(ComputeIdleMs());
+}
+
+void CALLBACK ApiPauseTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    EndApiPause();
+}
+
+// Pauses from several callers run until the latest end; ms = 0 resumes
+static void ApiPause(AdsPause& req)
+{
+    if (!req.ms)
+    {
+        EndApiPause();
+        req.pausedUntil = 0;
+        return;
+    }
+
+    const DWORD ms = (std::min)(req.ms, (uint32_t)ADS_MAX_PAUSE_MS);
+    const ULONGLONG until = GetTickCount64() + ms;
+
+    if (until > g_apiPauseUntil)
+    {
+        g_apiPauseUntil = until;
+        StopApiPauseTimer();
+        g_apiPauseTimerId = SetTimer(nullptr, 0, ms, ApiPauseTimerProc);
+    }
+
+    SetPaused(g_pausedApi, true);
+    req.pausedUntil = g_apiPauseUntil;
+    NotifyDebugChanged();
+}
+
+// Explicit request: runs through a pause, but not with autosave off
+static void ApiSaveNow(AdsSaveNow& req)
+{
+    req.saved = 0;
+    req.busy = 0;
+
+    if (!g_enabled || !g_ready || !g_hNppWnd) return;
+    if (g_saveBusy)
+    {
+        req.busy = 1;
+        return;
+    }
+
+    SyncVisibleDirtyState();
+
+    std::vector<UINT_PTR> ids;
+    for (const BufferEntry& e : g_buffers)
+        if (IsBufferPending(e) && (!req.bufferId || e.id == req.bufferId)) ids.push_back(e.id);
+
+    if (ids.empty()) return;
+
+    TraceLoggingWrite(g_etwProvider, "TickFired", TraceLoggingLevel(WINEVENT_LEVEL_INFO), TraceLoggingWideString(L"plugin request", "Trigger"),
+        TraceLoggingUInt32((uint32_t)ids.size(), "Due"), TraceLoggingUInt32((uint32_t)g_deadlines.size(), "Scheduled"));
+
+    RunAutosave(ids);
+    req.saved = g_lastTickQueued + g_lastTickSaved;
+
+    ArmScheduler();
+}
+
+static void ApiIsPending(AdsPending& req)
+{
+    const BufferEntry* e = FindBuffer(req.bufferId);
+
+    req.pending = (e && IsBufferPending(*e)) ? 1u : 0u;
+    req.paused = IsAutosavePaused() ? 1u : 0u;
+    req.due = (req.pending && !req.paused && g_enabled && g_ready && e->due) ? (std::max)(e->due, g_warmupUntil) : 0;
+}
+
+// Filled as far as the caller's block reaches; size returns the bytes written
+static void ApiGetStats(MetricsBlock& out)
+{
+    MetricsBlock m{};
+    FillMetrics(m);
+
+    const size_t bytes = (std::min)((size_t)out.size, sizeof(MetricsBlock));
+    memcpy(&out, &m, bytes);
+    out.size = (uint32_t)bytes;
+}
+
+static void HandlePluginMessage(const CommunicationInfo& ci)
+{
+    if (!ci.info) return;
+
+    const uint32_t size = *(const uint32_t*)ci.info;
+
+    TraceLoggingWrite(g_etwProvider, "PluginCommand", TraceLoggingLevel(WINEVENT_LEVEL_INFO),
+        TraceLoggingInt32((int32_t)ci.internalMsg, "Command"),
+        TraceLoggingWideString(ci.srcModuleName ? ci.srcModuleName : L"", "Source"));
+
+    switch (ci.internalMsg)
+    {
+    case ADSM_SAVENOW:
+        if (size >= sizeof(AdsSaveNow)) ApiSaveNow(*(AdsSaveNow*)ci.info);
+        break;
+    case ADSM_PAUSE:
+        if (size >= sizeof(AdsPause)) ApiPause(*(AdsPause*)ci.info);
+        break;
+    case ADSM_ISPENDING:
+        if (size >= sizeof(AdsPending)) ApiIsPending(*(AdsPending*)ci.info);
+        break;
+    case ADSM_GETSTATS:
+        if (size >= offsetof(MetricsBlock, seq)) ApiGetStats(*(MetricsBlock*)ci.info);
+        break;
+    }
+}
+
+// ================================
+// Debug Window (Resizable, Scrollable)
+// ================================
+static const wchar_t* DBG_CLASS = L"AutoDaveSaveDbgWnd";
+
+static std::wstring FormatPct(const double pct)
+{
+    std::wstringstream ss;
+    ss << std::fixed << std::setprecision(1) << pct << L"%";
+    return ss.str();
+}
+
+// Earliest live deadlines, read from a sorted copy of the heap
+static void AppendNextDeadlines(std::wstringstream& ss, const size_t top)
+{
+    std::vector<Deadline> live;
+    live.reserve(g_deadlines.size());
+    for (const Deadline& d : g_deadlines)
+        if (IsDeadlineLive(d)) live.push_back(d);
+
+    if (live.empty())
+    {
+        ss << L"Next autosave: nothing pending\r\n";
+        return;
+    }
+
+    const size_t n = (std::min)(top, live.size());
+    std::partial_sort(live.begin(), live.begin() + (ptrdiff_t)n, live.end(),
+        [](const Deadline& a, const Deadline& b) { return a.due < b.due; });
+
+    const ULONGLONG now = GetTickCount64();
+    ss << L"Next autosaves (" << live.size() << L" scheduled):\r\n";
+
+    for (size_t i = 0; i < n; ++i)
+    {
+        const BufferEntry* e = FindBuffer(live[i].id);
+
+        ss << L"  " << ((live[i].due > now) ? FormatTickClock(live[i].due) : std::wstring(L"now"));
+        if (e && BufferIntervalMs(*e) != g_intervalMs) ss << L" (every " << FormatMMSS(BufferIntervalMs(*e) / 1000u) << L")";
+        if (e && e->costKnown) ss << L" [" << FormatMs(e->costMs) << L"]";
+        ss << L"  " << GetBufferPath(live[i].id) << L"\r\n";
+    }
+}
+
+// Tail of the telemetry ring, newest first
+static void AppendRecentEvents(std::wstringstream& ss, const size_t top)
+{
+    static const wchar_t* const kKinds[] = { L"saving", L"saved", L"skipped", L"failed" };
+    static const wchar_t* const kSources[] = { L"file", L"snapshot", L"writer" };
+
+    std::vector<TelemetryEvent> events;
+    if (!ReadTelemetry(events, top, [](const TelemetryEvent&) { return true; })) return;
+
+    ss << L"Recent events:\r\n";
+    for (const TelemetryEvent& ev : events)
+    {
+        ss << L"  " << FormatUtcClock(ev.time) << L" " << kSources[ev.source] << L" " << kKinds[ev.kind];
+        if (ev.kind == TelemetryEvent::SaveFinished) ss << L" " << FormatBytes(ev.bytes) << L" in " << FormatMs(ev.ms);
+        else if (ev.kind == TelemetryEvent::SaveSkipped) ss << L" (" << kSkipReasons[ev.detail] << L")";
+        else if (ev.kind == TelemetryEvent::SaveFailed && ev.detail == kSaveRejectedError) ss << L" (rejected by Notepad++)";
+        else if (ev.kind == TelemetryEvent::SaveFailed) ss << L" (error " << ev.detail << L")";
+        ss << L"  " << ev.path << L"\r\n";
+    }
+}
+
+static std::wstring BuildDebugText()
+{
+    std::wstringstream ss;
+
+    ss << L"Enabled: " << (g_enabled ? L"Yes" : L"No") << L"\r\n";
+    ss << L"Interval: " << g_minutes << L" minute(s)" << (g_idleMode ? L" cap" : L"")
+        << (g_adaptive ? L", adaptive to " + FormatPct(g_uiBudgetPct) + L" UI budget" : std::wstring()) << L"\r\n";
+    ss << L"Mode: " << (g_idleMode ? L"Save after " + std::to_wstring(g_idleSeconds) + L"s typing pause" : std::wstring(L"Fixed interval"))
+        << (g_saveOnLeave ? L", save on tab switch and focus loss" : L"")
+        << (g_snapshotOnly ? L", background snapshots only" : L"") << L"\r\n";
+    ss << L"Rules: " << g_rules.rules.size() << L" from Rules.txt";
+    if (!g_rules.badLines.empty())
+    {
+        ss << L", ignored line";
+        for (const size_t line : g_rules.badLines) ss << L" " << line;
+    }
+    ss << L"\r\n";
+
+    if (!g_enabled)
+    {
+        ss << L"Next autosave: n/a\r\n";
+    }
+    else if (!g_ready)
+    {
+        ss << L"Next autosave: waiting for Notepad++ to finish loading\r\n";
+    }
+    else if (IsAutosavePaused())
+    {
+        ss << L"Next autosave: paused (";
+        if (g_pausedLocked) ss << L"locked ";
+        if (g_pausedSuspended) ss << L"suspended ";
+        if (g_pausedSaver) ss << L"battery saver ";
+        if (g_pausedApi) ss << L"plugin request until " << FormatTickClock(g_apiPauseUntil) << L" ";
+        ss << L"since " << FormatTickClock(g_pauseStart) << L")\r\n";
+        ss << L"Pauses since start: " << g_pauseCount << L"\r\n";
+    }
+    else
+    {
+        const ULONGLONG now = GetTickCount64();
+        if (g_warmupUntil > now)
+            ss << L"Warm-up: no autosave before " << FormatTickClock(g_warmupUntil) << L"\r\n";
+
+        AppendNextDeadlines(ss, 5);
+
+        if (g_idleMode)
+            ss << L"Typing-pause save: " << (g_idleTimerId ? L"pending" : L"none") << L"\r\n";
+    }
+
+    TelemetryEvent ev;
+    const bool saved = LatestTelemetry(ev, [](const TelemetryEvent& t) { return t.kind == TelemetryEvent::SaveFinished && t.source != TelemetryEvent::Writer; });
+    ss << L"Last autosave at: " << (saved ? FormatUtcClock(ev.time) : std::wstring(L"n/a")) << L"\r\n";
+    ss << L"Last tick: " << g_lastTickSaved << L" saved, " << g_lastTickUntitled << L" untitled skipped, "
+        << g_lastTickHashSkipped << L" unchanged by hash (" << g_hashSkippedTotal << L" total)\r\n";
+    if (LatestTelemetry(ev, [](const TelemetryEvent& t) { return t.kind == TelemetryEvent::SaveFailed && t.source == TelemetryEvent::FileSave; }))
+        ss << L"Last save error: " << (ev.detail == kSaveRejectedError ? std::wstring(L"rejected by Notepad++") : std::to_wstring(ev.detail)) << L" at " << FormatUtcClock(ev.time) << L" (" << ev.path << L")\r\n";
+    else
+        ss << L"Last save error: none\r\n";
+    ss << L"Dirty buffers: " << g_dirtyCount << L" of " << g_buffers.size() << L" tracked\r\n";
+
+    AppendLatencyLine(ss, L"File save latency", g_fileLatency);
+    AppendLatencyLine(ss, L"Tick save latency", g_tickLatency);
+    ss << L"Bytes written: " << FormatBytes(g_lastTickBytes) << L" last tick, " << FormatBytes(g_totalBytes) << L" total\r\n";
+    {
+        std::lock_guard<std::mutex> lock(g_poolLock);
+        ss << L"Copy pool: " << g_pool.size() << L" blocks, " << FormatBytes(g_poolBytes) << L" held, "
+            << g_poolHits << L" reused, " << g_poolMisses << L" allocated\r\n";
+    }
+    AppendCostTable(ss, L"Costliest volumes", g_volumeCosts, 3);
+    AppendCostTable(ss, L"Costliest files", g_fileCosts, 5);
+
+    if (g_snapshotOnly)
+        ss << L"Snapshots: " << g_lastTickQueued << L" queued last tick\r\n";
+
+    if (g_saveOnLeave)
+        ss << L"Leave saves: " << g_leaveTicks << L" ticks on tab switch or focus loss of " << g_ticksRun << L" total\r\n";
+
+    if (g_sessionCheckpoint)
+        ss << L"Tab checkpoint: " << g_sessionTabs << L" tabs, " << g_sessionWrites << L" written, "
+            << g_sessionUnchanged << L" unchanged" << (g_sessionTimerId ? L", change pending" : L"") << L"\r\n";
+
+    if (g_journal)
+        ss << L"Journal: " << g_journalAppended << L" bytes handed to writer, " << g_journalCompactions << L" compactions\r\n";
 
-    g_lastErrValid = false;
-    g_lastErrCode = 0;
+    ss << L"Skipped for backpressure: " << g_busyTicksSkipped << L" ticks during a save, "
+        << g_backpressureTotal << L" snapshots behind the writer (last tick " << g_lastTickBackpressure << L")\r\n";
+    ss << L"Throttled: " << g_lastTickThrottled << L" tabs deferred last tick, " << g_throttledTotal << L" total\r\n";
+    for (const VolumeBucket& b : g_volumeBuckets)
+    {
+        ss << L"  " << b.key << L": " << FormatBytes((uint64_t)b.budget.bytesPerSec) << L"/s, "
+            << (int)b.budget.opsPerSec << L" saves/s, " << (b.bytes > 0 && b.ops >= 1.0 ? L"open" : L"resting") << L"\r\n";
+    }
 
-    if (!PostMessageW(g_hNppWnd, NPPM_MENUCOMMAND, 0, CMD_SAVEALL))
+    if (g_coordView)
     {
-        g_lastErrValid = true;
-        g_lastErrCode = GetLastError();
+        ss << L"Instances: " << g_coordLive << L" sharing the coordinator, " << g_coordDeferred << L" ticks deferred a turn, "
+            << g_coordDeduped << L" saves already done by another instance (last tick " << g_lastTickDeduped << L")\r\n";
     }
-    else
+    if (g_saveBusy)
+        ss << L"Save in flight: " << (g_inflightId ? GetBufferPath(g_inflightId) : std::wstring(L"journal or snapshot")) << L"\r\n";
+
+    if (g_history)
+        ss << L"History: " << g_versionsStored.load() << L" versions (" << g_versionsCloned.load() << L" block clones), "
+            << FormatBytes(g_versionRawBytes.load()) << L" stored as " << FormatBytes(g_versionStoredBytes.load())
+            << (Cabinet().Usable() ? L"" : L" (compression unavailable)") << L"\r\n";
+
+    if (g_snapshotOnly || g_journal || g_history)
     {
-        g_lastSaveValid = true;
-        GetLocalTime(&g_lastSaveLocal);
+        ss << L"Writer: " << g_writerThreads.size() << L" threads, " << WriterQueueDepth() << L" pending, " << g_writesDone.load() << L" done, " << g_writesFailed.load() << L" failed\r\n";
+        if (LatestTelemetry(ev, [](const TelemetryEvent& t) { return t.kind == TelemetryEvent::SaveFailed && t.source == TelemetryEvent::Writer; }))
+            ss << L"Last writer error: " << ev.detail << L" at " << FormatUtcClock(ev.time) << L" (" << ev.path << L")\r\n";
+        else
+            ss << L"Last writer error: none\r\n";
     }
+    AppendRecentEvents(ss, 8);
+    ss << L"\r\n";
 
-    const ULONGLONG now = GetTickCount64();
-    g_nextTick = now + g_intervalMs;
+    ss << L"Notes:\r\n";
+    ss << L"- Only modified, named files are saved; untitled tabs are left alone.\r\n";
+    ss << L"- Each modified tab has its own deadline; nothing runs while all tabs are clean.\r\n";
+    ss << L"- Timers coalesce with other wakeups and hold while locked, asleep or on battery saver.\r\n";
+    ss << L"- This view refreshes when autosave state changes, and not while hidden or minimized.\r\n";
 
-    if (g_debug && g_hDbgWnd)
-        PostMessageW(g_hDbgWnd, WM_TIMER, (WPARAM)g_dbgTimerId, 0);
+    return ss.str();
 }
 
-static void StartAutosaveTimer()
+static void ReplaceDbgRange(const size_t start, const size_t end, const std::wstring& text)
 {
-    g_intervalMs = ComputeIntervalMs(g_minutes);
+    SendMessageW(g_hDbgEdit, EM_SETSEL, (WPARAM)start, (LPARAM)end);
+    SendMessageW(g_hDbgEdit, EM_REPLACESEL, FALSE, (LPARAM)text.c_str());
+}
 
-    StopAutosaveTimer();
-    g_autosaveTimerId = SetTimer(nullptr, 0, g_intervalMs, AutosaveTimerProc);
+// Rewrite only the lines that differ from what is on screen. Unchanged text
+// is not repainted, and the reader's scroll position and selection survive.
+static void SetDbgText(const std::wstring& text)
+{
+    if (!g_hDbgEdit) return;
 
-    const ULONGLONG now = GetTickCount64();
-    g_nextTick = now + g_intervalMs;
-}
+    std::vector<std::wstring> lines;
+    for (size_t at = 0; at < text.size();)
+    {
+        size_t eol = text.find(L"\r\n", at);
+        if (eol == std::wstring::npos) eol = text.size();
+        lines.push_back(text.substr(at, eol - at));
+        at = eol + 2;
+    }
 
-// ================================
-// Debug Window (Resizable, Scrollable)
-// ================================
-static const wchar_t* DBG_CLASS = L"AutoDaveSaveDbgWnd";
+    if (g_dbgLines.empty())
+    {
+        SetWindowTextW(g_hDbgEdit, text.c_str());
+        g_dbgLines = std::move(lines);
+        return;
+    }
 
-static std::wstring BuildDebugText()
-{
-    std::wstringstream ss;
+    const std::vector<std::wstring>& old = g_dbgLines;
+    const size_t common = (std::min)(old.size(), lines.size());
 
-    ss << L"Enabled: " << (g_enabled ? L"Yes" : L"No") << L"\r\n";
-    ss << L"Interval: " << g_minutes << L" minute(s)\r\n";
+    size_t prefix = 0;
+    while (prefix < common && old[prefix] == lines[prefix]) ++prefix;
+    if (prefix == old.size() && prefix == lines.size()) return;
 
-    if (!g_enabled)
+    size_t suffix = 0;
+    while (suffix < common - prefix && old[old.size() - 1 - suffix] == lines[lines.size() - 1 - suffix]) ++suffix;
+
+    size_t start = 0;
+    for (size_t i = 0; i < prefix; ++i) start += old[i].size() + 2;
+
+    DWORD selStart = 0, selEnd = 0;
+    SendMessageW(g_hDbgEdit, EM_GETSEL, (WPARAM)&selStart, (LPARAM)&selEnd);
+    const LRESULT topLine = SendMessageW(g_hDbgEdit, EM_GETFIRSTVISIBLELINE, 0, 0);
+
+    if (old.size() == lines.size())
     {
-        ss << L"Next autosave: n/a\r\n";
+        // Same shape: each changed line on its own
+        for (size_t i = prefix; i < lines.size() - suffix; ++i)
+        {
+            if (old[i] != lines[i]) ReplaceDbgRange(start, start + old[i].size(), lines[i]);
+            start += lines[i].size() + 2;
+        }
     }
     else
     {
-        const ULONGLONG now = GetTickCount64();
-        DWORD remainSec = 0;
-        if (g_nextTick > now)
-            remainSec = (DWORD)((g_nextTick - now) / 1000u);
+        size_t end = start;
+        for (size_t i = prefix; i < old.size() - suffix; ++i) end += old[i].size() + 2;
 
-        ss << L"Next autosave in: " << FormatMMSS(remainSec) << L"\r\n";
+        std::wstring block;
+        for (size_t i = prefix; i < lines.size() - suffix; ++i) block += lines[i] + L"\r\n";
+        ReplaceDbgRange(start, end, block);
     }
 
-    ss << L"Last autosave at: " << (g_lastSaveValid ? FormatHHMMSS(g_lastSaveLocal) : L"n/a") << L"\r\n";
-    ss << L"Last PostMessage error: " << (g_lastErrValid ? std::to_wstring(g_lastErrCode) : L"none") << L"\r\n\r\n";
-
-    ss << L"Notes:\r\n";
-    ss << L"- Untitled tabs can trigger Save As dialogs.\r\n";
-    ss << L"- Debug refresh interval: 1 second.\r\n";
+    SendMessageW(g_hDbgEdit, EM_SETSEL, selStart, selEnd);
+    const LRESULT nowTop = SendMessageW(g_hDbgEdit, EM_GETFIRSTVISIBLELINE, 0, 0);
+    if (nowTop != topLine) SendMessageW(g_hDbgEdit, EM_LINESCROLL, 0, topLine - nowTop);
 
-    return ss.str();
+    g_dbgLines = std::move(lines);
 }
 
-static void SetDbgText(const std::wstring& text)
+// Rebuild now, or later when hidden, minimized or refreshed very recently
+static void RefreshDebugView(HWND hwnd)
 {
-    if (!g_hDbgEdit) return;
-    SetWindowTextW(g_hDbgEdit, text.c_str());
+    if (!g_debug || !g_hDbgEdit) return;
+
+    if (!IsWindowVisible(hwnd) || IsIconic(hwnd))
+    {
+        g_dbgStale = true;
+        return;
+    }
+
+    const ULONGLONG now = GetTickCount64();
+    if (g_dbgLastRefresh && now - g_dbgLastRefresh < (ULONGLONG)kDbgMinRefreshMs)
+    {
+        if (!g_dbgTimerId)
+            g_dbgTimerId = SetTimer(hwnd, kDbgTimerId, (UINT)(kDbgMinRefreshMs - (now - g_dbgLastRefresh)), nullptr);
+        return;
+    }
+
+    g_dbgStale = false;
+    g_dbgLastRefresh = now;
+    SetDbgText(BuildDebugText());
 }
 
 static void SizeDebugControls(HWND hwnd)
@@ -313,15 +5833,30 @@ static LRESULT CALLBACK DbgWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
     case WM_SIZE:
     {
         SizeDebugControls(hwnd);
+        if (wParam != SIZE_MINIMIZED && g_dbgStale) NotifyDebugChanged();
+        return 0;
+    }
+
+    case WM_SHOWWINDOW:
+    {
+        if (wParam && g_dbgStale) NotifyDebugChanged();
+        return 0;
+    }
+
+    case kDbgRefreshMsg:
+    {
+        g_dbgPosted = false;
+        RefreshDebugView(hwnd);
         return 0;
     }
 
     case WM_TIMER:
     {
-        if ((UINT_PTR)wParam != g_dbgTimerId) return 0;
-        if (!g_debug) return 0;
+        if ((UINT_PTR)wParam != kDbgTimerId) return 0;
 
-        SetDbgText(BuildDebugText());
+        KillTimer(hwnd, kDbgTimerId);
+        g_dbgTimerId = 0;
+        RefreshDebugView(hwnd);
         return 0;
     }
 
@@ -342,6 +5877,9 @@ static LRESULT CALLBACK DbgWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lP
 
     case WM_DESTROY:
     {
+        g_dbgNotifyWnd = nullptr;
+        g_dbgPosted = false;
+        g_dbgLines.clear();
         g_hDbgWnd = nullptr;
         g_hDbgEdit = nullptr;
         return 0;
@@ -371,6 +5909,7 @@ static void ShowDebugWindow()
     {
         ShowWindow(g_hDbgWnd, SW_SHOW);
         SetForegroundWindow(g_hDbgWnd);
+        NotifyDebugChanged();
         return;
     }
 
@@ -401,18 +5940,15 @@ static void ShowDebugWindow()
 
     if (!g_hDbgWnd) return;
 
+    g_dbgNotifyWnd = g_hDbgWnd;
     ShowWindow(g_hDbgWnd, SW_SHOW);
-
-    g_dbgTimerId = kDbgTimerId;
-    SetTimer(g_hDbgWnd, g_dbgTimerId, kDbgTimerRefreshMs, nullptr);
-
-    PostMessageW(g_hDbgWnd, WM_TIMER, (WPARAM)g_dbgTimerId, 0);
 }
 
 static void HideDebugWindow()
 {
     if (!g_hDbgWnd) return;
 
+    g_dbgNotifyWnd = nullptr;
     if (g_dbgTimerId)
     {
         KillTimer(g_hDbgWnd, g_dbgTimerId);
@@ -453,10 +5989,14 @@ static std::wstring AboutText()
     t += L"How to use\r\n";
     t += L"1) Plugins > AutoDaveSave > Start or Stop Autosave\r\n";
     t += L"2) Select interval: 1, 3, or 10 minutes\r\n";
+    t += L"   Optional: Save When Typing Pauses (interval becomes a cap)\r\n";
+    t += L"   Optional: Background Snapshots Only (shadow copies, files untouched)\r\n";
+    t += L"   Optional: Journal Changes Between Saves (crash recovery by replay)\r\n";
     t += L"3) Optional: Show Timer Selection (Debug)\r\n\r\n";
 
     t += L"Notes\r\n";
-    t += L"- Untitled tabs can trigger Save As prompts when Save All runs\r\n\r\n";
+    t += L"- Only modified files that already have a name are saved\r\n";
+    t += L"- Untitled tabs are skipped, so no Save As prompt appears\r\n\r\n";
 
     // Non-corny, short, and relevant line
     t += L"Contact\r\n";
@@ -639,15 +6179,18 @@ static void ToggleAutosave()
     g_enabled = !g_enabled;
 
     if (g_enabled) StartAutosaveTimer();
-    else StopAutosaveTimer();
+    else
+    {
+        StopAutosaveTimer();
+        StopIdleTimer();
+    }
 
     ApplyChecks();
 
     if (g_debug)
         ShowDebugWindow();
 
-    if (g_debug && g_hDbgWnd)
-        PostMessageW(g_hDbgWnd, WM_TIMER, (WPARAM)g_dbgTimerId, 0);
+    NotifyDebugChanged();
 }
 
 static void SetMinutes(const int m)
@@ -667,6 +6210,347 @@ static void Set1() { SetMinutes(1); }
 static void Set3() { SetMinutes(3); }
 static void Set10() { SetMinutes(10); }
 
+static void ToggleIdleMode()
+{
+    g_idleMode = !g_idleMode;
+
+    if (!g_idleMode)
+        StopIdleTimer();
+
+    ApplyChecks();
+
+    NotifyDebugChanged();
+}
+
+static void ToggleSaveOnLeave()
+{
+    g_saveOnLeave = !g_saveOnLeave;
+
+    ApplyChecks();
+
+    NotifyDebugChanged();
+}
+
+static void ToggleAdaptive()
+{
+    g_adaptive = !g_adaptive;
+
+    if (g_enabled)
+        RebuildSchedule();
+
+    ApplyChecks();
+
+    NotifyDebugChanged();
+}
+
+// Per-tab override: default -> 30 seconds -> 10 minutes -> default
+static void CycleTabInterval()
+{
+    if (!g_hNppWnd) return;
+
+    const UINT_PTR id = (UINT_PTR)SendMessageW(g_hNppWnd, NPPM_GETCURRENTBUFFERID, 0, 0);
+    if (!id) return;
+
+    BufferEntry& e = TouchBuffer(id);
+    if (e.intervalMs == 0) e.intervalMs = 30u * 1000u;
+    else if (e.intervalMs == 30u * 1000u) e.intervalMs = 10u * 60u * 1000u;
+    else e.intervalMs = 0;
+
+    RebuildSchedule();
+
+    NotifyDebugChanged();
+}
+
+static void ToggleSnapshotOnly()
+{
+    g_snapshotOnly = !g_snapshotOnly;
+    ResyncSchedule();
+
+    ApplyChecks();
+
+    NotifyDebugChanged();
+}
+
+static void ToggleJournal()
+{
+    g_journal = !g_journal;
+
+    if (!g_journal)
+    {
+        // Journals are only valid while every delta is recorded
+        StopJournalTimer();
+        for (BufferEntry& e : g_buffers)
+        {
+            if (!e.journalOpen && e.journal.empty()) continue;
+
+            e.journalOpen = false;
+            e.journalFresh = false;
+            e.journalDrop = true;
+            e.journal.clear();
+        }
+        JournalFlush();
+    }
+
+    ApplyChecks();
+
+    NotifyDebugChanged();
+}
+
+// Replace the current tab's text with recovered bytes. The change is a
+// single undo step and leaves the tab modified for review.
+static void ReplaceCurrentText(const UINT_PTR id, const std::wstring& path, const std::string& text)
+{
+    int which = 0;
+    SendMessageW(g_hNppWnd, NPPM_GETCURRENTSCINTILLA, 0, (LPARAM)&which);
+    const HWND hSci = (which == 1) ? g_hSciSecond : g_hSciMain;
+    if (!hSci) return;
+
+    // Record the recovered text as a new base instead of journaling the rewrite
+    const bool journal = g_journal;
+    g_journal = false;
+
+    SendMessageW(hSci, SCI_BEGINUNDOACTION, 0, 0);
+    SendMessageW(hSci, SCI_CLEARALL, 0, 0);
+    SendMessageW(hSci, SCI_APPENDTEXT, (WPARAM)text.size(), (LPARAM)text.data());
+    SendMessageW(hSci, SCI_ENDUNDOACTION, 0, 0);
+
+    g_journal = journal;
+
+    if (g_journal)
+    {
+        SyncVisibleDirtyState();
+
+        BufferEntry& e = TouchBuffer(id);
+        e.cleanBase = false;
+        JournalBegin(e, path, 0, &text);
+        JournalFlush();
+    }
+}
+
+// Menu: rebuild the current tab from what its journal describes
+static void RecoverFromJournal()
+{
+    if (!g_hNppWnd) return;
+
+    const UINT_PTR id = (UINT_PTR)SendMessageW(g_hNppWnd, NPPM_GETCURRENTBUFFERID, 0, 0);
+    const std::wstring path = GetBufferPath(id);
+    const std::wstring jrnPath = JournalPathFor(path);
+
+    std::string jrn, text;
+    if (jrnPath.empty() || !ReadWholeFile(jrnPath, jrn) || !ReplayJournal(jrn, text))
+    {
+        MessageBoxW(g_hNppWnd, L"No usable journal was found for the current tab.", L"AutoDaveSave", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    ReplaceCurrentText(id, path, text);
+}
+
+static void ToggleHistory()
+{
+    g_history = !g_history;
+    ApplyChecks();
+}
+
+static std::wstring FormatVersionTime(const uint64_t utc)
+{
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+    const uint64_t nowU = FileTimeU64(now);
+    const DWORD agoSec = (nowU > utc) ? (DWORD)((nowU - utc) / 10000000ull) : 0;
+
+    return FormatUtcClock(utc) + L" (" + FormatMMSS(agoSec) + L" ago)";
+}
+
+// Walk back through the ring, newest first, until the user picks a version
+static void RestoreFromHistory()
+{
+    if (!g_hNppWnd) return;
+
+    const UINT_PTR id = (UINT_PTR)SendMessageW(g_hNppWnd, NPPM_GETCURRENTBUFFERID, 0, 0);
+    const std::wstring path = GetBufferPath(id);
+    const std::wstring index = HistoryIndexFor(path);
+    const std::vector<HistorySlot> versions = index.empty() ? std::vector<HistorySlot>() : ReadHistoryIndex(index);
+
+    if (versions.empty())
+    {
+        MessageBoxW(g_hNppWnd, L"No earlier versions were found for the current tab.", L"AutoDaveSave", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    for (size_t i = 0; i < versions.size(); ++i)
+    {
+        std::wstringstream ss;
+        ss << L"Version " << (i + 1) << L" of " << versions.size() << L", saved " << FormatVersionTime(versions[i].time)
+            << L", " << FormatBytes(versions[i].rawSize) << L".\r\n\r\n"
+            << L"Yes: restore this version (Undo brings the current text back)\r\n"
+            << L"No: show an older version\r\n"
+            << L"Cancel: keep the current text";
+
+        const int answer = MessageBoxW(g_hNppWnd, ss.str().c_str(), L"AutoDaveSave", MB_YESNOCANCEL | MB_ICONQUESTION);
+        if (answer == IDCANCEL) return;
+        if (answer == IDNO) continue;
+
+        std::string text;
+        if (!LoadVersion(index, versions[i], text))
+        {
+            MessageBoxW(g_hNppWnd, L"That version could not be read or failed its checksum.", L"AutoDaveSave", MB_OK | MB_ICONWARNING);
+            return;
+        }
+
+        ReplaceCurrentText(id, path, text);
+        return;
+    }
+}
+
+static void ToggleSessionCheckpoint()
+{
+    g_sessionCheckpoint = !g_sessionCheckpoint;
+
+    if (g_sessionCheckpoint)
+    {
+        g_sessionHash = 0;
+        NoteSessionChanged();
+    }
+    else
+        StopSessionTimer();
+
+    ApplyChecks();
+    NotifyDebugChanged();
+}
+
+// Menu: reopen the tabs checkpointed by the previous run, or by this one
+// when there is none. Tabs already open are only switched to.
+static void LoadSessionCheckpoint()
+{
+    if (!g_hNppWnd) return;
+
+    std::wstring path = SessionPath(true);
+    if (path.empty() || GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+        path = SessionPath();
+
+    if (path.empty() || GetFileAttributesW(path.c_str()) == INVALID_FILE_ATTRIBUTES)
+    {
+        MessageBoxW(g_hNppWnd, L"No tab checkpoint was found. Select Checkpoint Open Tabs to keep one.", L"AutoDaveSave", MB_OK | MB_ICONINFORMATION);
+        return;
+    }
+
+    SendMessageW(g_hNppWnd, NPPM_LOADSESSION, 0, (LPARAM)path.c_str());
+}
+
+// Map last session's index; nothing is read from Journal or Backup here
+static void OpenRecoveryIndex()
+{
+    FILETIME now{};
+    GetSystemTimeAsFileTime(&now);
+    g_sessionStart = FileTimeU64(now);
+
+    const std::wstring dir = PluginDataDir(nullptr);
+    if (dir.empty()) return;
+
+    const std::wstring path = dir + L"\\recovery.adsr";
+    {
+        std::lock_guard<std::mutex> lock(g_writerLock);
+        g_recoveryPath = path;
+    }
+
+    if (!g_recoveryView.Open(path, kRecoveryIndexBytes, false) || !RecoveryHeaderValid(g_recoveryView.view))
+        g_recoveryView.Close();
+}
+
+// Offer the newest copy left by an earlier session when it differs from
+// the open text. Only this tab's journal or backup is read.
+static void CheckRecovery(const UINT_PTR id)
+{
+    const std::wstring path = GetBufferPath(id);
+    if (!IsNamedPath(path) || !g_recoveryView.view) return;
+
+    const RecoveryEntry* entry = FindRecoveryEntry(g_recoveryView.view, HashPath(path), false);
+    if (!entry) return;
+    const RecoveryEntry found = *entry;   // The writer may update it meanwhile
+
+    uint64_t hash = 0, length = 0;
+    if (!HashBufferText(id, hash, length)) return;
+
+    std::string text;
+    const wchar_t* source = nullptr;
+    uint64_t when = 0;
+
+    if ((found.sources & kRecoverySnapshot) && found.snapTime < g_sessionStart && found.snapHash != hash)
+    {
+        std::string bak;
+        if (ReadWholeFile(BackupPathFor(path), bak) && bak.size() == found.snapLength && Xxh64(bak.data(), bak.size()) == found.snapHash)
+        {
+            text.swap(bak);
+            source = L"background snapshot";
+            when = found.snapTime;
+        }
+    }
+
+    if ((found.sources & kRecoveryJournal) && found.journalTime < g_sessionStart && found.journalTime > when)
+    {
+        std::string jrn, replayed;
+        if (ReadWholeFile(JournalPathFor(path), jrn) && ReplayJournal(jrn, replayed) && Xxh64(replayed.data(), replayed.size()) != hash)
+        {
+            text.swap(replayed);
+            source = L"change journal";
+            when = found.journalTime;
+        }
+    }
+
+    if (!source) return;
+
+    std::wstringstream ss;
+    ss << L"Text for this file from an earlier session was found (" << source << L", " << FormatVersionTime(when)
+        << L") and differs from the open tab:\r\n\r\n" << path << L"\r\n\r\n"
+        << L"Replace the tab's text with it? Undo brings the current text back.";
+
+    if (MessageBoxW(g_hNppWnd, ss.str().c_str(), L"AutoDaveSave", MB_YESNO | MB_ICONQUESTION) == IDYES)
+        ReplaceCurrentText(id, path, text);
+}
+
+// Deferred out of beNotified; a tab that is no longer current waits for its
+// next activation
+void CALLBACK RecoveryTimerProc(HWND, UINT, UINT_PTR, DWORD)
+{
+    KillTimer(nullptr, g_recoveryTimerId);
+    g_recoveryTimerId = 0;
+    if (!g_hNppWnd) return;
+
+    std::vector<UINT_PTR> pending;
+    pending.swap(g_recoveryPending);
+
+    for (const UINT_PTR id : pending)
+    {
+        BufferEntry* e = FindBuffer(id);
+        if (!e || e->recoveryChecked) continue;
+        if ((UINT_PTR)SendMessageW(g_hNppWnd, NPPM_GETCURRENTBUFFERID, 0, 0) != id) continue;
+
+        e->recoveryChecked = true;
+        CheckRecovery(id);
+    }
+}
+
+static void QueueRecoveryCheck(const UINT_PTR id)
+{
+    if (!g_recoveryView.view || !id) return;
+
+    const BufferEntry* e = FindBuffer(id);
+    if (e && e->recoveryChecked) return;
+
+    g_recoveryPending.push_back(id);
+    if (!g_recoveryTimerId)
+        g_recoveryTimerId = SetTimer(nullptr, 0, USER_TIMER_MINIMUM, RecoveryTimerProc);
+}
+
+static void StopRecoveryChecks()
+{
+    if (g_recoveryTimerId) KillTimer(nullptr, g_recoveryTimerId);
+    g_recoveryTimerId = 0;
+    g_recoveryPending.clear();
+    g_recoveryView.Close();
+}
+
 static void ToggleDebug()
 {
     g_debug = !g_debug;
@@ -688,6 +6572,15 @@ static void ShowAbout()
 static void Cleanup()
 {
     StopAutosaveTimer();
+    StopIdleTimer();
+    StopApiPauseTimer();
+    StopPoolTimer();
+    StopJournalTimer();
+    StopSessionTimer();
+    StopPowerWatch();
+    StopRecoveryChecks();
+    StopCoordinator();
+    StopMetricsExport();
 
     if (g_hDbgWnd)
         HideDebugWindow();
@@ -700,7 +6593,19 @@ static void Cleanup()
     g_hAboutBtnRepo = nullptr;
     g_hAboutBtnLinkedIn = nullptr;
 
+    // Joined at NPPN_SHUTDOWN, after which QueueWrite starts no workers;
+    // never block inside DllMain
+    assert(g_writerThreads.empty());
+
+    StopTracing();
+
+    g_buffers.clear();
+    g_dirtyCount = 0;
+    g_staleCount = 0;
+
     g_hNppWnd = nullptr;
+    g_hSciMain = nullptr;
+    g_hSciSecond = nullptr;
 }
 
 // ================================
@@ -708,13 +6613,16 @@ static void Cleanup()
 // ================================
 extern "C" __declspec(dllexport) void setInfo(void* data)
 {
+    StartTracing();
+
     const NppData* pData = static_cast<const NppData*>(data);
     g_hNppWnd = pData ? pData->_nppHandle : nullptr;
+    g_hSciMain = pData ? pData->_scintillaMainHandle : nullptr;
+    g_hSciSecond = pData ? pData->_scintillaSecondHandle : nullptr;
 
-    // Hard-coded defaults applied on every startup
-    g_minutes = 3;
-    g_enabled = true;
-    g_debug = false;
+    // Saved settings and rules, before the menu takes its checkmarks
+    LoadSettings();
+    LoadRules();
 
     ZeroMemory(g_items, sizeof(g_items));
 
@@ -730,6 +6638,42 @@ extern "C" __declspec(dllexport) void setInfo(void* data)
     wcscpy_s(g_items[FUNC_10MIN]._itemName, L"Set Autosave to 10 Minutes");
     g_items[FUNC_10MIN]._pFunc = Set10;
 
+    wcscpy_s(g_items[FUNC_ADAPTIVE]._itemName, L"Adapt Interval To Save Cost");
+    g_items[FUNC_ADAPTIVE]._pFunc = ToggleAdaptive;
+
+    wcscpy_s(g_items[FUNC_IDLE]._itemName, L"Save When Typing Pauses");
+    g_items[FUNC_IDLE]._pFunc = ToggleIdleMode;
+
+    wcscpy_s(g_items[FUNC_LEAVE]._itemName, L"Save When Leaving A Tab");
+    g_items[FUNC_LEAVE]._pFunc = ToggleSaveOnLeave;
+
+    wcscpy_s(g_items[FUNC_TABINTERVAL]._itemName, L"Cycle Current Tab Interval");
+    g_items[FUNC_TABINTERVAL]._pFunc = CycleTabInterval;
+
+    wcscpy_s(g_items[FUNC_SNAPSHOT]._itemName, L"Background Snapshots Only");
+    g_items[FUNC_SNAPSHOT]._pFunc = ToggleSnapshotOnly;
+
+    wcscpy_s(g_items[FUNC_JOURNAL]._itemName, L"Journal Changes Between Saves");
+    g_items[FUNC_JOURNAL]._pFunc = ToggleJournal;
+
+    wcscpy_s(g_items[FUNC_RECOVER]._itemName, L"Recover Current Tab From Journal");
+    g_items[FUNC_RECOVER]._pFunc = RecoverFromJournal;
+
+    wcscpy_s(g_items[FUNC_HISTORY]._itemName, L"Keep Version History");
+    g_items[FUNC_HISTORY]._pFunc = ToggleHistory;
+
+    wcscpy_s(g_items[FUNC_RESTORE]._itemName, L"Restore Earlier Version Of Current Tab");
+    g_items[FUNC_RESTORE]._pFunc = RestoreFromHistory;
+
+    wcscpy_s(g_items[FUNC_SESSION]._itemName, L"Checkpoint Open Tabs");
+    g_items[FUNC_SESSION]._pFunc = ToggleSessionCheckpoint;
+
+    wcscpy_s(g_items[FUNC_LOADSESSION]._itemName, L"Reopen Tabs From Previous Run");
+    g_items[FUNC_LOADSESSION]._pFunc = LoadSessionCheckpoint;
+
+    wcscpy_s(g_items[FUNC_RULES]._itemName, L"Edit Autosave Rules");
+    g_items[FUNC_RULES]._pFunc = EditRules;
+
     wcscpy_s(g_items[FUNC_DEBUG]._itemName, L"Show Timer Selection (Debug)");
     g_items[FUNC_DEBUG]._pFunc = ToggleDebug;
 
@@ -738,7 +6682,8 @@ extern "C" __declspec(dllexport) void setInfo(void* data)
 
     UpdateInitChecks();
 
-    // Hard-coded startup behavior: start autosave immediately
+    // Armed once NPPN_READY arrives
+    g_ready = false;
     StartAutosaveTimer();
 }
 
@@ -757,13 +6702,135 @@ extern "C" __declspec(dllexport) FuncItem* getFuncsArray(int* count)
 extern "C" __declspec(dllexport) void beNotified(void* notifyCode)
 {
     const SCNotification* scn = static_cast<const SCNotification*>(notifyCode);
+    if (!scn) return;
+
+    const NMHDR& hdr = scn->nmhdr;
 
-    if (scn && scn->nmhdr.code == NPPN_READY)
+    // Scintilla notifications come from the view that shows the buffer
+    if (hdr.hwndFrom && (hdr.hwndFrom == g_hSciMain || hdr.hwndFrom == g_hSciSecond))
+    {
+        switch (hdr.code)
+        {
+        case SCN_SAVEPOINTLEFT:
+            SetBufferDirty(BufferIdForView(hdr.hwndFrom), true);
+            break;
+        case SCN_SAVEPOINTREACHED:
+            SetBufferDirty(BufferIdForView(hdr.hwndFrom), false);
+            break;
+        case SCN_UPDATEUI:
+            if (g_sessionCheckpoint && (scn->updated & (SC_UPDATE_SELECTION | SC_UPDATE_V_SCROLL)) && CaptureViewPosition(hdr.hwndFrom))
+                NoteSessionChanged();
+            break;
+        case SCN_MODIFIED:
+            if (scn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+            {
+                MarkViewEdited(hdr.hwndFrom);
+                if (g_journal) JournalRecord(hdr.hwndFrom, *scn);
+                NoteEditActivity();
+            }
+            break;
+        }
+        return;
+    }
+
+    // Notepad++ notifications carry the BufferID in idFrom
+    switch (hdr.code)
+    {
+    case NPPN_READY:
+        SyncVisibleDirtyState();
         UpdateRuntimeChecks();
+        StartPowerWatch();
+        StartCoordinator();
+        StartMetricsExport();
+        PublishMetrics();
+        OpenRecoveryIndex();
+        for (const UINT_PTR id : g_viewBuffer) QueueRecoveryCheck(id);
+        RotateSessionCheckpoint();
+        BeginAutosaveAfterWarmup();
+        NoteSessionChanged();
+        break;
+    case NPPN_FILESAVED:
+        if (g_inflightId && hdr.idFrom == g_inflightId)
+            g_inflightDone = QpcNow();
+        SetBufferDirty(hdr.idFrom, false);
+        RecordSavedHash(hdr.idFrom);
+        PublishSave(hdr.idFrom);
+        ForgetBackup(hdr.idFrom);
+        if (IsRulesFile(hdr.idFrom)) LoadRules();
+        else RefreshRules(hdr.idFrom);
+        NoteSessionChanged();   // Save As gives the tab a new path
+        break;
+    case NPPN_FILERENAMED:
+        RefreshRules(hdr.idFrom);
+        NoteSessionChanged();
+        break;
+    case NPPN_FILEOPENED:
+        SetBufferDirty(hdr.idFrom, false);
+        NoteSessionChanged();
+        break;
+    case NPPN_DOCORDERCHANGED:
+        NoteSessionChanged();
+        break;
+    case NPPN_SNAPSHOTDIRTYFILELOADED:
+        SetBufferDirty(hdr.idFrom, true);
+        SetBufferStale(TouchBuffer(hdr.idFrom), true);
+        break;
+    case NPPN_FILEBEFORECLOSE:
+        if (g_journal) JournalDiscard(hdr.idFrom);
+        ForgetBackup(hdr.idFrom);
+        break;
+    case NPPN_FILECLOSED:
+        RemoveBuffer(hdr.idFrom);
+        NoteSessionChanged();
+        break;
+    case NPPN_BUFFERACTIVATED:
+    {
+        const UINT_PTR shown[2] = { g_viewBuffer[MAIN_VIEW], g_viewBuffer[SUB_VIEW] };
+        SyncVisibleDirtyState();
+
+        // Hash clean buffers once, when first looked at, instead of at open
+        for (const UINT_PTR id : g_viewBuffer)
+        {
+            const BufferEntry* e = FindBuffer(id);
+            if (e && !e->dirty && !e->savedHashKnown) RecordSavedHash(id);
+            QueueRecoveryCheck(id);
+        }
+
+        // A buffer no view shows any more was just left; save it once the
+        // switch has painted
+        if (g_saveOnLeave && g_hPowerWnd)
+            for (const UINT_PTR id : shown)
+                if (id && id != g_viewBuffer[MAIN_VIEW] && id != g_viewBuffer[SUB_VIEW])
+                    PostMessageW(g_hPowerWnd, kLeaveSaveMsg, (WPARAM)id, 0);
+
+        NoteSessionChanged();
+        break;
+    }
+    case NPPN_SHUTDOWN:
+        // Join the writer here; DllMain runs under the loader lock
+        StopAutosaveTimer();
+        StopIdleTimer();
+        StopApiPauseTimer();
+        StopPoolTimer();
+        StopJournalTimer();
+        StopSessionTimer();
+        StopPowerWatch();
+        StopRecoveryChecks();
+        StopCoordinator();
+        StopMetricsExport();
+        if (g_journal) JournalFlush();
+        ReleaseReaderView();
+        StopWriter();
+        break;
+    }
 }
 
-extern "C" __declspec(dllexport) LRESULT messageProc(UINT, WPARAM, LPARAM)
+extern "C" __declspec(dllexport) LRESULT messageProc(UINT msg, WPARAM, LPARAM lParam)
 {
+    // Notepad++ relays NPPM_MSGTOPLUGIN with the sender's CommunicationInfo
+    if (msg == NPPM_MSGTOPLUGIN && lParam)
+        HandlePluginMessage(*(const CommunicationInfo*)lParam);
+
     return TRUE;
 }
 
@@ -0,0 +1,133 @@
+/*
+Copyright 2026 - Dave Stewart
+
+Licensed under the Apache License, Version 2.0 (the "License");
+Licensed use requires compliance with the License.
+A copy of the License is available at LICENSE or at:
+http://www.apache.org/licenses/LICENSE-2.0
+*/
+
+// Public interface of AutoDaveSave for other Notepad++ plugins.
+//
+// Commands go through NPPM_MSGTOPLUGIN and run synchronously on the
+// Notepad++ UI thread; results come back in the structure passed as info:
+//
+//   AdsPause pause{ sizeof(AdsPause), 30000 };
+//   CommunicationInfo ci{ ADSM_PAUSE, L"MyPlugin.dll", &pause };
+//   SendMessage(nppHandle, NPPM_MSGTOPLUGIN, (WPARAM)L"AutoDaveSave.dll", (LPARAM)&ci);
+//
+// Every structure starts with its size; set it to sizeof before sending.
+// Newer versions only append fields. A command whose structure is smaller
+// than this version expects is ignored, except that a MetricsBlock is filled
+// as far as its size reaches.
+
+#pragma once
+
+#include <windows.h>
+#include <cstdint>
+
+// ================================
+// Commands (CommunicationInfo::internalMsg)
+// ================================
+// Save every pending tab now, or just the one named by bufferId. Ignores an
+// ADSM_PAUSE, but not autosave being switched off.
+#define ADSM_SAVENOW    1   // info: AdsSaveNow*
+
+// Hold autosave for ms milliseconds, e.g. around a large replace-all or a
+// build. Pauses from several callers run until the latest one ends; ms = 0
+// ends the pause at once. Capped at ADS_MAX_PAUSE_MS.
+#define ADSM_PAUSE      2   // info: AdsPause*
+
+// Whether a tab has unsaved work autosave will pick up, and when.
+#define ADSM_ISPENDING  3   // info: AdsPending*
+
+// Counters from the metrics block, without opening the shared mapping.
+// size comes back as the number of bytes filled.
+#define ADSM_GETSTATS   4   // info: MetricsBlock* (size set by the caller)
+
+#define ADS_MAX_PAUSE_MS (30u * 60u * 1000u)
+
+struct AdsSaveNow
+{
+    uint32_t  size;
+    UINT_PTR  bufferId;     // 0 = every pending tab
+    uint32_t  saved;        // Out: files saved (or snapshots queued)
+    uint32_t  busy;         // Out: 1 when a save was already running; nothing was done
+};
+
+struct AdsPause
+{
+    uint32_t  size;
+    uint32_t  ms;
+    uint64_t  pausedUntil;  // Out: GetTickCount64 value the pause ends at, 0 = not paused
+};
+
+struct AdsPending
+{
+    uint32_t  size;
+    UINT_PTR  bufferId;
+    uint32_t  pending;      // Out: 1 when the tab has unsaved work
+    uint32_t  paused;       // Out: 1 while autosave is held (pause, lock, suspend, battery saver)
+    uint64_t  due;          // Out: GetTickCount64 value of its next save, 0 = none scheduled
+};
+
+// ================================
+// Metrics Block
+// ================================
+// Also published in the named mapping "Local\AutoDaveSave.Metrics.<pid>"
+// (one per Notepad++ process). The layout below is version 1 and only ever
+// grows at the end; readers check magic, version and size. seq is odd while
+// the UI thread updates the mapping: copy it, then re-read seq and retry if
+// it moved or was odd. Times are UTC FILETIME (0 = never), latencies
+// milliseconds.
+static constexpr uint32_t kMetricsMagic = 0x584D4441; // "ADMX"
+static constexpr uint32_t kMetricsVersion = 1;
+
+// lastErrorCode when Notepad++ refused the save (NPPM_SAVEFILE returned
+// FALSE); other values are Win32 error codes. Bit 29 marks it as
+// application-defined.
+static constexpr uint32_t kSaveRejectedError = 0x20000001;
+
+struct MetricsBlock
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;              // sizeof(MetricsBlock) of the writer
+    uint32_t pid;
+    uint64_t seq;
+    uint64_t updated;
+
+    uint32_t enabled;
+    uint32_t mode;              // 0 save files, 1 snapshots only
+    uint32_t intervalMs;
+    uint32_t dirtyBuffers;
+    uint32_t trackedBuffers;
+    uint32_t scheduled;
+    uint64_t lastSave;          // Last file saved or snapshot queued
+    uint64_t lastError;         // Time of the last failed file save
+    uint32_t lastErrorCode;
+    uint32_t lastWriterErrorCode;
+
+    uint64_t ticks;
+    uint64_t filesSaved;
+    uint64_t snapshotsQueued;
+    uint64_t unchangedSkipped;
+    uint64_t otherInstanceSkipped;
+    uint64_t throttled;
+    uint64_t backpressure;
+    uint64_t busyTicksSkipped;
+
+    uint64_t bytesSaved;
+    uint64_t journalBytes;
+    uint64_t versionsStored;
+    uint64_t versionRawBytes;
+    uint64_t versionStoredBytes;
+    uint64_t writerDone;
+    uint64_t writerFailed;
+    uint64_t writerPending;
+
+    double   fileP50, fileP95, fileP99, fileMax;
+    double   tickP50, tickP95, tickP99, tickMax;
+};
+
+static_assert(sizeof(MetricsBlock) % 8 == 0, "metrics block layout");
@@ -0,0 +1,643 @@
+/*
+Copyright 2026 - Dave Stewart
+
+Licensed under the Apache License, Version 2.0 (the "License");
+Licensed use requires compliance with the License.
+A copy of the License is available at LICENSE or at:
+http://www.apache.org/licenses/LICENSE-2.0
+*/
+
+// Headless host for AutoDaveSave. Loads the plugin DLL against mock
+// Notepad++ and Scintilla windows, simulates N open buffers of which a share
+// is edited before every tick, asks the plugin to save them with
+// ADSM_SAVENOW and reports the plugin's UI-thread time, the span from the
+// tick's first file save to its last, and bytes written per tick.
+//
+//   AutoDaveSaveBench [--dll path] [--buffers N] [--size bytes] [--dirty ratio] [--ticks T]
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "../AutoDaveSaveMsgs.h"
+
+// ================================
+// Plugin Interface (mirrors AudoDaveSave.cpp)
+// ================================
+#define NPPMSG                  (WM_USER + 1000)
+#define NPPM_GETCURRENTSCINTILLA (NPPMSG + 4)
+#define NPPM_CREATESCINTILLAHANDLE (NPPMSG + 20)
+#define NPPM_GETCURRENTDOCINDEX (NPPMSG + 23)
+#define NPPM_SETMENUITEMCHECK   (NPPMSG + 40)
+#define NPPM_GETPLUGINSCONFIGDIR (NPPMSG + 46)
+#define NPPM_MSGTOPLUGIN        (NPPMSG + 47)
+#define NPPM_GETFULLPATHFROMBUFFERID (NPPMSG + 58)
+#define NPPM_GETBUFFERIDFROMPOS (NPPMSG + 59)
+#define NPPM_GETCURRENTBUFFERID (NPPMSG + 60)
+#define NPPM_GETBUFFERENCODING  (NPPMSG + 66)
+#define NPPM_SAVEFILE           (NPPMSG + 94)
+
+#define MAIN_VIEW               0
+#define SUB_VIEW                1
+
+#define NPPN_FIRST              1000
+#define NPPN_READY              (NPPN_FIRST + 1)
+#define NPPN_FILEOPENED         (NPPN_FIRST + 4)
+#define NPPN_FILESAVED          (NPPN_FIRST + 8)
+#define NPPN_SHUTDOWN           (NPPN_FIRST + 9)
+#define NPPN_BUFFERACTIVATED    (NPPN_FIRST + 10)
+
+#define SCI_CLEARALL            2004
+#define SCI_GETLENGTH           2006
+#define SCI_SETSAVEPOINT        2014
+#define SCI_BEGINUNDOACTION     2078
+#define SCI_ENDUNDOACTION       2079
+#define SCI_GETMODIFY           2159
+#define SCI_APPENDTEXT          2282
+#define SCI_GETDOCPOINTER       2357
+#define SCI_SETDOCPOINTER       2358
+#define SCI_ADDREFDOCUMENT      2376
+#define SCI_RELEASEDOCUMENT     2377
+#define SCI_GETCHARACTERPOINTER 2520
+
+#define SCN_SAVEPOINTREACHED    2002
+#define SCN_SAVEPOINTLEFT       2003
+#define SCN_MODIFIED            2008
+
+#define SC_MOD_INSERTTEXT       0x1
+
+struct FuncItem
+{
+    wchar_t _itemName[64];
+    void (*_pFunc)();
+    int _cmdID;
+    bool _init2Check;
+    void* _pShKey;
+};
+
+struct NppData
+{
+    HWND _nppHandle;
+    HWND _scintillaMainHandle;
+    HWND _scintillaSecondHandle;
+};
+
+struct SCNotification
+{
+    NMHDR nmhdr;
+    intptr_t position;
+    int ch;
+    int modifiers;
+    int modificationType;
+    const char* text;
+    intptr_t length;
+    intptr_t linesAdded;
+    int message;
+    uintptr_t wParam;
+    intptr_t lParam;
+    intptr_t line;
+    int foldLevelNow;
+    int foldLevelPrev;
+    int margin;
+    int listType;
+    int x;
+    int y;
+    int token;
+    intptr_t annotationLinesAdded;
+    int updated;
+    int listCompletionMethod;
+    int characterSource;
+};
+
+struct CommunicationInfo
+{
+    long internalMsg;
+    const wchar_t* srcModuleName;
+    void* info;
+};
+
+typedef void (*SetInfoFn)(void*);
+typedef FuncItem* (*GetFuncsArrayFn)(int*);
+typedef void (*BeNotifiedFn)(void*);
+typedef LRESULT (*MessageProcFn)(UINT, WPARAM, LPARAM);
+
+// ================================
+// Host State
+// ================================
+struct MockDoc
+{
+    std::string text;
+    bool        modified = false;
+};
+
+struct MockBuffer
+{
+    UINT_PTR     id = 0;
+    std::wstring path;
+    MockDoc*     doc = nullptr;
+};
+
+struct Options
+{
+    std::wstring dll;
+    size_t buffers = 50;
+    size_t size = 64 * 1024;
+    double dirty = 0.5;
+    size_t ticks = 3;
+};
+
+static std::vector<std::unique_ptr<MockDoc>> g_docs;
+static std::vector<MockBuffer> g_mockBuffers;
+static size_t g_activeIndex = 0;
+
+static HWND g_hNpp = nullptr;
+static HWND g_hMain = nullptr;
+static HWND g_hSecond = nullptr;
+static std::wstring g_configDir;
+
+static BeNotifiedFn g_beNotified = nullptr;
+static MessageProcFn g_messageProc = nullptr;
+
+// Tick counters
+static size_t   g_saves = 0;
+static uint64_t g_bytesSaved = 0;
+static LONGLONG g_firstSaveAt = 0;
+static LONGLONG g_lastSaveAt = 0;
+static LARGE_INTEGER g_qpcFreq{};
+
+static double QpcMs(const LONGLONG ticks)
+{
+    return (double)ticks * 1000.0 / (double)g_qpcFreq.QuadPart;
+}
+
+static LONGLONG QpcNow()
+{
+    LARGE_INTEGER t{};
+    QueryPerformanceCounter(&t);
+    return t.QuadPart;
+}
+
+// Time spent inside the plugin on this thread: notifications and its timers
+static LONGLONG g_pluginTicks = 0;
+
+static void Notify(const UINT code, const HWND from, const UINT_PTR id, const int modType = 0)
+{
+    SCNotification scn{};
+    scn.nmhdr.code = code;
+    scn.nmhdr.hwndFrom = from;
+    scn.nmhdr.idFrom = id;
+    scn.modificationType = modType;
+
+    const LONGLONG start = QpcNow();
+    g_beNotified(&scn);
+    g_pluginTicks += QpcNow() - start;
+}
+
+static MockBuffer* FindMockBuffer(const UINT_PTR id)
+{
+    for (MockBuffer& b : g_mockBuffers)
+        if (b.id == id) return &b;
+    return nullptr;
+}
+
+static MockBuffer* FindMockBufferByPath(const wchar_t* path)
+{
+    for (MockBuffer& b : g_mockBuffers)
+        if (_wcsicmp(b.path.c_str(), path) == 0) return &b;
+    return nullptr;
+}
+
+static MockDoc* NewDoc()
+{
+    g_docs.push_back(std::make_unique<MockDoc>());
+    return g_docs.back().get();
+}
+
+// ================================
+// Mock Scintilla
+// ================================
+static const wchar_t* SCI_CLASS = L"AutoDaveSaveBenchScintilla";
+
+static MockDoc* ViewDoc(const HWND hwnd)
+{
+    return reinterpret_cast<MockDoc*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+}
+
+static LRESULT CALLBACK SciWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    MockDoc* doc = ViewDoc(hwnd);
+
+    switch (msg)
+    {
+    case SCI_GETLENGTH:
+        return doc ? (LRESULT)doc->text.size() : 0;
+    case SCI_GETCHARACTERPOINTER:
+        return doc ? (LRESULT)doc->text.c_str() : 0;
+    case SCI_GETMODIFY:
+        return (doc && doc->modified) ? 1 : 0;
+    case SCI_GETDOCPOINTER:
+        return (LRESULT)doc;
+    case SCI_SETDOCPOINTER:
+        SetWindowLongPtrW(hwnd, GWLP_USERDATA, (LONG_PTR)(lParam ? (MockDoc*)lParam : NewDoc()));
+        return 0;
+    case SCI_SETSAVEPOINT:
+        if (doc && doc->modified)
+        {
+            doc->modified = false;
+            if (hwnd == g_hMain) Notify(SCN_SAVEPOINTREACHED, hwnd, 0);
+        }
+        return 0;
+    case SCI_CLEARALL:
+        if (doc) doc->text.clear();
+        return 0;
+    case SCI_APPENDTEXT:
+        if (doc) doc->text.append((const char*)lParam, (size_t)wParam);
+        return 0;
+    case SCI_ADDREFDOCUMENT:
+    case SCI_RELEASEDOCUMENT:
+    case SCI_BEGINUNDOACTION:
+    case SCI_ENDUNDOACTION:
+        return 0; // Documents live until the host exits
+    }
+
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+static HWND CreateSciView(const HWND parent)
+{
+    HWND hwnd = CreateWindowExW(0, SCI_CLASS, L"", WS_CHILD, 0, 0, 0, 0, parent, nullptr, GetModuleHandleW(nullptr), nullptr);
+    if (hwnd) SetWindowLongPtrW(hwnd, GWLP_USERDATA, (LONG_PTR)NewDoc());
+    return hwnd;
+}
+
+// ================================
+// Mock Notepad++
+// ================================
+static const wchar_t* NPP_CLASS = L"AutoDaveSaveBenchNpp";
+
+static bool WriteMockFile(const std::wstring& path, const std::string& text)
+{
+    HANDLE h = CreateFileW(path.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (h == INVALID_HANDLE_VALUE) return false;
+
+    DWORD written = 0;
+    const BOOL ok = WriteFile(h, text.data(), (DWORD)text.size(), &written, nullptr);
+    CloseHandle(h);
+    return ok && written == text.size();
+}
+
+// Notepad++ writes the document, flags it clean and announces the save
+static LRESULT SaveMockFile(const wchar_t* path)
+{
+    MockBuffer* b = path ? FindMockBufferByPath(path) : nullptr;
+    if (!b || !WriteMockFile(b->path, b->doc->text)) return FALSE;
+
+    ++g_saves;
+    g_bytesSaved += b->doc->text.size();
+    g_lastSaveAt = QpcNow();
+    if (!g_firstSaveAt) g_firstSaveAt = g_lastSaveAt;
+
+    const bool wasModified = b->doc->modified;
+    b->doc->modified = false;
+
+    SCNotification scn{};
+    scn.nmhdr.code = NPPN_FILESAVED;
+    scn.nmhdr.hwndFrom = g_hNpp;
+    scn.nmhdr.idFrom = b->id;
+    g_beNotified(&scn);
+
+    if (wasModified && b->doc == ViewDoc(g_hMain))
+    {
+        scn.nmhdr.code = SCN_SAVEPOINTREACHED;
+        scn.nmhdr.hwndFrom = g_hMain;
+        scn.nmhdr.idFrom = 0;
+        g_beNotified(&scn);
+    }
+    return TRUE;
+}
+
+static LRESULT CALLBACK NppWndProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+    switch (msg)
+    {
+    case NPPM_GETCURRENTSCINTILLA:
+        if (lParam) *(int*)lParam = MAIN_VIEW;
+        return 0;
+    case NPPM_CREATESCINTILLAHANDLE:
+        return (LRESULT)CreateSciView(hwnd);
+    case NPPM_GETCURRENTDOCINDEX:
+        return (lParam == MAIN_VIEW) ? (LRESULT)g_activeIndex : -1;
+    case NPPM_GETBUFFERIDFROMPOS:
+        return (lParam == MAIN_VIEW && wParam < g_mockBuffers.size()) ? (LRESULT)g_mockBuffers[wParam].id : 0;
+    case NPPM_GETCURRENTBUFFERID:
+        return (LRESULT)g_mockBuffers[g_activeIndex].id;
+    case NPPM_GETFULLPATHFROMBUFFERID:
+    {
+        const MockBuffer* b = FindMockBuffer((UINT_PTR)wParam);
+        if (!b) return -1;
+        if (lParam) wcscpy_s((wchar_t*)lParam, b->path.size() + 1, b->path.c_str());
+        return (LRESULT)b->path.size();
+    }
+    case NPPM_GETPLUGINSCONFIGDIR:
+        if (lParam) wcsncpy_s((wchar_t*)lParam, (size_t)wParam, g_configDir.c_str(), _TRUNCATE);
+        return TRUE;
+    case NPPM_GETBUFFERENCODING:
+        return 4; // UTF-8 without BOM
+    case NPPM_SETMENUITEMCHECK:
+        return TRUE;
+    case NPPM_SAVEFILE:
+        return SaveMockFile((const wchar_t*)lParam);
+    }
+
+    return DefWindowProcW(hwnd, msg, wParam, lParam);
+}
+
+static bool CreateMockWindows()
+{
+    WNDCLASSEXW wc{};
+    wc.cbSize = sizeof(wc);
+    wc.hInstance = GetModuleHandleW(nullptr);
+
+    wc.lpfnWndProc = SciWndProc;
+    wc.lpszClassName = SCI_CLASS;
+    if (!RegisterClassExW(&wc)) return false;
+
+    wc.lpfnWndProc = NppWndProc;
+    wc.lpszClassName = NPP_CLASS;
+    if (!RegisterClassExW(&wc)) return false;
+
+    g_hNpp = CreateWindowExW(0, NPP_CLASS, L"Notepad++ (bench)", WS_OVERLAPPEDWINDOW, 0, 0, 640, 480,
+        nullptr, nullptr, wc.hInstance, nullptr);
+    if (!g_hNpp) return false;
+
+    g_hMain = CreateSciView(g_hNpp);
+    g_hSecond = CreateSciView(g_hNpp);
+    return g_hMain && g_hSecond;
+}
+
+// ================================
+// Workload
+// ================================
+static uint64_t g_rng = 0x9E3779B97F4A7C15ull;
+
+static uint64_t NextRandom()
+{
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 7;
+    g_rng ^= g_rng << 17;
+    return g_rng;
+}
+
+// Source-like text: words, indentation and line breaks
+static std::string MakeText(const size_t size)
+{
+    static const char* const kWords[] = { "int", "value", "return", "if", "for", "const", "size_t", "buffer", "=", "+", "(", ")", ";" };
+
+    std::string text;
+    text.reserve(size + 64);
+    while (text.size() < size)
+    {
+        text += "    ";
+        for (int w = 0; w < 8; ++w)
+        {
+            text += kWords[NextRandom() % (sizeof(kWords) / sizeof(kWords[0]))];
+            text += ' ';
+        }
+        text += "\r\n";
+    }
+    text.resize(size);
+    return text;
+}
+
+static void ActivateBuffer(const size_t index)
+{
+    g_activeIndex = index;
+    SetWindowLongPtrW(g_hMain, GWLP_USERDATA, (LONG_PTR)g_mockBuffers[index].doc);
+    Notify(NPPN_BUFFERACTIVATED, g_hNpp, g_mockBuffers[index].id);
+}
+
+// Type one line into a buffer the way Scintilla reports it
+static void EditBuffer(const size_t index)
+{
+    ActivateBuffer(index);
+
+    MockDoc* doc = g_mockBuffers[index].doc;
+    doc->text += "// edited\r\n";
+
+    const bool wasModified = doc->modified;
+    doc->modified = true;
+
+    Notify(SCN_MODIFIED, g_hMain, 0, SC_MOD_INSERTTEXT);
+    if (!wasModified) Notify(SCN_SAVEPOINTLEFT, g_hMain, 0);
+}
+
+// The command another plugin would send through Notepad++
+static void SendSaveNow()
+{
+    AdsSaveNow req{};
+    req.size = sizeof(req);
+
+    CommunicationInfo ci{ ADSM_SAVENOW, L"AutoDaveSaveBench.exe", &req };
+
+    const LONGLONG start = QpcNow();
+    g_messageProc(NPPM_MSGTOPLUGIN, (WPARAM)L"AutoDaveSave.dll", (LPARAM)&ci);
+    g_pluginTicks += QpcNow() - start;
+}
+
+// Ask for saves until the plugin has saved `expected` files or the timeout
+// passes. Tabs held back by the volume throttle are asked for again once
+// its budget could have refilled. Thread timers (hwnd == nullptr) belong to
+// the plugin and are timed.
+static void SaveUntilDone(const size_t expected, const DWORD timeoutMs)
+{
+    const ULONGLONG deadline = GetTickCount64() + timeoutMs;
+
+    for (;;)
+    {
+        SendSaveNow();
+        if (g_saves >= expected || GetTickCount64() >= deadline) break;
+
+        MsgWaitForMultipleObjects(0, nullptr, FALSE, 50, QS_ALLINPUT);
+
+        MSG msg{};
+        while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+        {
+            const bool pluginTimer = (msg.message == WM_TIMER && !msg.hwnd);
+            const LONGLONG start = QpcNow();
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+            if (pluginTimer) g_pluginTicks += QpcNow() - start;
+        }
+    }
+}
+
+static bool ParseOptions(const int argc, wchar_t** argv, Options& opt)
+{
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        const std::wstring key = argv[i];
+        const wchar_t* value = argv[i + 1];
+
+        if (key == L"--dll") opt.dll = value;
+        else if (key == L"--buffers") opt.buffers = (size_t)_wtoi64(value);
+        else if (key == L"--size") opt.size = (size_t)_wtoi64(value);
+        else if (key == L"--dirty") opt.dirty = _wtof(value);
+        else if (key == L"--ticks") opt.ticks = (size_t)_wtoi64(value);
+        else return false;
+    }
+
+    if (argc % 2 == 0) return false;
+    opt.dirty = (std::min)(1.0, (std::max)(0.0, opt.dirty));
+    return opt.buffers > 0 && opt.ticks > 0;
+}
+
+// Scratch files and the plugin's config folder go with the host
+static void DeleteTree(const std::wstring& dir)
+{
+    WIN32_FIND_DATAW fd{};
+    HANDLE h = FindFirstFileW((dir + L"\\*").c_str(), &fd);
+    if (h != INVALID_HANDLE_VALUE)
+    {
+        do
+        {
+            if (wcscmp(fd.cFileName, L".") == 0 || wcscmp(fd.cFileName, L"..") == 0) continue;
+
+            const std::wstring path = dir + L"\\" + fd.cFileName;
+            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) DeleteTree(path);
+            else DeleteFileW(path.c_str());
+        } while (FindNextFileW(h, &fd));
+        FindClose(h);
+    }
+    RemoveDirectoryW(dir.c_str());
+}
+
+// ================================
+// Entry Point
+// ================================
+int wmain(int argc, wchar_t** argv)
+{
+    Options opt;
+    if (!ParseOptions(argc, argv, opt))
+    {
+        fwprintf(stderr, L"usage: AutoDaveSaveBench [--dll path] [--buffers N] [--size bytes] [--dirty ratio] [--ticks T]\n");
+        return 2;
+    }
+    QueryPerformanceFrequency(&g_qpcFreq);
+
+    // Plugin DLL defaults to the one built next to this host
+    wchar_t exe[MAX_PATH] = {};
+    GetModuleFileNameW(nullptr, exe, MAX_PATH);
+    std::wstring exeDir = exe;
+    exeDir.resize(exeDir.find_last_of(L"\\/") + 1);
+    if (opt.dll.empty()) opt.dll = exeDir + L"AutoDaveSave.dll";
+
+    // Scratch tree: files and the plugin's config folder
+    wchar_t temp[MAX_PATH] = {};
+    GetTempPathW(MAX_PATH, temp);
+    const std::wstring root = std::wstring(temp) + L"AutoDaveSaveBench." + std::to_wstring(GetCurrentProcessId());
+    g_configDir = root + L"\\config";
+    const std::wstring files = root + L"\\files";
+    CreateDirectoryW(root.c_str(), nullptr);
+    CreateDirectoryW(g_configDir.c_str(), nullptr);
+    CreateDirectoryW(files.c_str(), nullptr);
+
+    if (!CreateMockWindows())
+    {
+        fwprintf(stderr, L"could not create mock windows (%lu)\n", GetLastError());
+        DeleteTree(root);
+        return 1;
+    }
+
+    for (size_t i = 0; i < opt.buffers; ++i)
+    {
+        MockBuffer b;
+        b.id = 0x10000 + i * 16;
+        b.path = files + L"\\file" + std::to_wstring(i) + L".txt";
+        b.doc = NewDoc();
+        b.doc->text = MakeText(opt.size);
+        WriteMockFile(b.path, b.doc->text);
+        g_mockBuffers.push_back(b);
+    }
+
+    HMODULE plugin = LoadLibraryW(opt.dll.c_str());
+    if (!plugin)
+    {
+        fwprintf(stderr, L"could not load %ls (%lu)\n", opt.dll.c_str(), GetLastError());
+        DeleteTree(root);
+        return 1;
+    }
+
+    const SetInfoFn setInfo = (SetInfoFn)GetProcAddress(plugin, "setInfo");
+    const GetFuncsArrayFn getFuncsArray = (GetFuncsArrayFn)GetProcAddress(plugin, "getFuncsArray");
+    g_beNotified = (BeNotifiedFn)GetProcAddress(plugin, "beNotified");
+    g_messageProc = (MessageProcFn)GetProcAddress(plugin, "messageProc");
+    if (!setInfo || !getFuncsArray || !g_beNotified || !g_messageProc)
+    {
+        fwprintf(stderr, L"%ls is missing plugin exports\n", opt.dll.c_str());
+        FreeLibrary(plugin);
+        DeleteTree(root);
+        return 1;
+    }
+
+    NppData npp{ g_hNpp, g_hMain, g_hSecond };
+    setInfo(&npp);
+
+    int count = 0;
+    FuncItem* items = getFuncsArray(&count);
+    for (int i = 0; i < count; ++i) items[i]._cmdID = 22000 + i;
+
+    for (const MockBuffer& b : g_mockBuffers) Notify(NPPN_FILEOPENED, g_hNpp, b.id);
+    ActivateBuffer(0);
+    Notify(NPPN_READY, g_hNpp, 0);
+
+    // Ticks are driven through ADSM_SAVENOW: no interval or warm-up to wait out
+    const size_t dirtyPerTick = (std::max)((size_t)1, (size_t)((double)opt.buffers * opt.dirty + 0.5));
+    wprintf(L"%zu buffers of %zu bytes, %zu edited per tick, %zu ticks\n\n", opt.buffers, opt.size, dirtyPerTick, opt.ticks);
+    wprintf(L"tick  saved  bytes        plugin UI ms  per file ms  save span ms\n");
+
+    double totalUi = 0.0;
+    uint64_t totalBytes = 0;
+    size_t totalSaved = 0;
+
+    for (size_t t = 0; t < opt.ticks; ++t)
+    {
+        g_saves = 0;
+        g_bytesSaved = 0;
+        g_pluginTicks = 0;
+        g_firstSaveAt = 0;
+        g_lastSaveAt = 0;
+
+        // A different share of the buffers each tick
+        std::vector<size_t> order(opt.buffers);
+        for (size_t i = 0; i < order.size(); ++i) order[i] = i;
+        for (size_t i = order.size(); i > 1; --i) std::swap(order[i - 1], order[NextRandom() % i]);
+        for (size_t i = 0; i < dirtyPerTick; ++i) EditBuffer(order[i]);
+
+        SaveUntilDone(dirtyPerTick, 30000);
+        const double spanMs = QpcMs(g_lastSaveAt - g_firstSaveAt);
+        const double uiMs = QpcMs(g_pluginTicks);
+
+        wprintf(L"%4zu  %5zu  %-11llu  %12.2f  %11.3f  %12.2f\n", t + 1, g_saves, (unsigned long long)g_bytesSaved,
+            uiMs, g_saves ? uiMs / (double)g_saves : 0.0, spanMs);
+
+        totalUi += uiMs;
+        totalBytes += g_bytesSaved;
+        totalSaved += g_saves;
+    }
+
+    wprintf(L"\ntotal: %zu files, %llu bytes, %.2f ms plugin UI time (%.3f ms per file)\n",
+        totalSaved, (unsigned long long)totalBytes, totalUi, totalSaved ? totalUi / (double)totalSaved : 0.0);
+
+    Notify(NPPN_SHUTDOWN, g_hNpp, 0);
+    FreeLibrary(plugin);
+    DestroyWindow(g_hNpp);
+    DeleteTree(root);
+
+    return totalSaved == dirtyPerTick * opt.ticks ? 0 : 1;
+}